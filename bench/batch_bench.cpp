@@ -0,0 +1,92 @@
+#include "../include/batch.h"
+#include "bench.h"
+
+#include <tuple>
+#include <vector>
+
+namespace {
+
+/* eight numeric fields, 40 bytes packed */
+using Record =
+    std::tuple<uint32_t, uint32_t, uint16_t, uint16_t, uint64_t, int32_t,
+               double, float>;
+
+} // namespace
+
+void bench_batch() {
+    const size_t n = 10 * 1000;
+    const size_t rounds = 100;
+    const PhPacker::Format format("NVnvJlEg");
+    std::vector<Record> records;
+    for (size_t i = 0; i < n; ++i) {
+        records.emplace_back(
+            static_cast<uint32_t>(i), static_cast<uint32_t>(i * 7),
+            static_cast<uint16_t>(i), static_cast<uint16_t>(i >> 3),
+            uint64_t{i} << 32, -static_cast<int32_t>(i),
+            static_cast<double>(i) * 0.25, static_cast<float>(i));
+    }
+    const double bytes = static_cast<double>(n * rounds * format.size());
+
+    bench::report("Format::pack per record", bench::measure([&] {
+                      for (size_t r = 0; r < rounds; ++r) {
+                          std::string out;
+                          out.reserve(n * format.size());
+                          for (const Record &rec : records) {
+                              out += std::apply(
+                                  [&](const auto &...v) {
+                                      return format.pack(v...);
+                                  },
+                                  rec);
+                          }
+                          bench::keep(out);
+                      }
+                  }),
+                  bytes);
+
+    bench::report("Format::pack_to per record", bench::measure([&] {
+                      for (size_t r = 0; r < rounds; ++r) {
+                          std::string out(n * format.size(), '\0');
+                          char *dst = &out[0];
+                          for (const Record &rec : records) {
+                              dst += std::apply(
+                                  [&](const auto &...v) {
+                                      return format.pack_to(
+                                          dst, format.size(), v...);
+                                  },
+                                  rec);
+                          }
+                          bench::keep(out);
+                      }
+                  }),
+                  bytes);
+
+    std::string packed;
+    bench::report("pack_batch", bench::measure([&] {
+                      for (size_t r = 0; r < rounds; ++r) {
+                          packed = PhPacker::pack_batch(format, records);
+                          bench::keep(packed);
+                      }
+                  }),
+                  bytes);
+
+    bench::report("Format::unpack per record", bench::measure([&] {
+                      for (size_t r = 0; r < rounds / 10; ++r) {
+                          for (size_t i = 0; i < n; ++i) {
+                              bench::keep(format.unpack(std::string_view(
+                                  packed.data() + i * format.size(),
+                                  format.size())));
+                          }
+                      }
+                  }),
+                  bytes / 10);
+
+    std::vector<Record> decoded(n);
+    bench::report("unpack_batch", bench::measure([&] {
+                      for (size_t r = 0; r < rounds; ++r) {
+                          PhPacker::unpack_batch(format, packed,
+                                                 decoded.data(), n);
+                          bench::keep(decoded);
+                      }
+                  }),
+                  bytes);
+}
@@ -0,0 +1,45 @@
+#ifndef PHPACK_BENCH_H
+#define PHPACK_BENCH_H
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace bench {
+
+/* keeps the optimizer from dropping a result */
+template <typename T> inline void keep(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static const void *volatile sink;
+    sink = &value;
+#endif
+}
+
+/**
+ * runs f until at least min_time has passed and returns the fastest run in
+ * seconds
+ */
+template <typename F> double measure(F &&f, double min_time = 0.25) {
+    using clock = std::chrono::steady_clock;
+    double best = 1e30;
+    double total = 0;
+    do {
+        const auto start = clock::now();
+        f();
+        const std::chrono::duration<double> elapsed = clock::now() - start;
+        best = elapsed.count() < best ? elapsed.count() : best;
+        total += elapsed.count();
+    } while (total < min_time);
+    return best;
+}
+
+inline void report(const std::string &name, double seconds, double bytes) {
+    std::printf("%-48s %10.3f ms %9.2f GB/s\n", name.c_str(), seconds * 1e3,
+                bytes / seconds / 1e9);
+}
+
+} // namespace bench
+
+#endif /* PHPACK_BENCH_H */
@@ -0,0 +1,72 @@
+#include "../include/bulk.h"
+#include "../include/format.h"
+#include "bench.h"
+
+#include <numeric>
+#include <thread>
+#include <vector>
+
+void bench_bulk() {
+    const size_t n = 16 * 1024 * 1024;
+    std::vector<uint64_t> values(n);
+    std::iota(values.begin(), values.end(), 0);
+    std::string out(n * 8, '\0');
+    const double bytes = static_cast<double>(out.size());
+
+    bench::report("pack('J') per value",
+                  bench::measure([&] {
+                      for (size_t i = 0; i < n / 16; ++i) {
+                          bench::keep(PhPacker::pack('J', values[i]));
+                      }
+                  }),
+                  bytes / 16);
+
+    bench::report("pack_array('J')", bench::measure([&] {
+                      PhPacker::pack_array('J', values.data(), n, &out[0]);
+                      bench::keep(out);
+                  }),
+                  bytes);
+
+    std::vector<uint64_t> decoded(n);
+    bench::report("unpack_array('J')", bench::measure([&] {
+                      PhPacker::unpack_array('J', out.data(), n,
+                                             decoded.data());
+                      bench::keep(decoded);
+                  }),
+                  bytes);
+
+    /* 16 bit exports of 32 bit values that all fit */
+    std::vector<uint32_t> narrow(n);
+    for (size_t i = 0; i < n; ++i) {
+        narrow[i] = static_cast<uint32_t>(i & 0xffff);
+    }
+    const double narrow_bytes = static_cast<double>(n * 2);
+    const PhPacker::Conversion conversions[] = {
+        PhPacker::Conversion::Wrap, PhPacker::Conversion::Check,
+        PhPacker::Conversion::Saturate};
+    const char *const conversion_names[] = {"wrap", "check", "saturate"};
+    for (size_t c = 0; c < 3; ++c) {
+        bench::report(std::string("pack_array('n') ") + conversion_names[c],
+                      bench::measure([&] {
+                          PhPacker::pack_array('n', narrow.data(), n, &out[0],
+                                               conversions[c]);
+                          bench::keep(out);
+                      }),
+                      narrow_bytes);
+    }
+
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    double single = 0;
+    for (unsigned threads = 1; threads <= cores; threads *= 2) {
+        const double t = bench::measure([&] {
+            PhPacker::pack_array_parallel('J', values.data(), n, &out[0],
+                                          PhPacker::ThreadExecutor(), threads);
+            bench::keep(out);
+        });
+        single = threads == 1 ? t : single;
+        bench::report("pack_array_parallel('J') x" + std::to_string(threads) +
+                          " (" + std::to_string(single / t).substr(0, 4) +
+                          "x)",
+                      t, bytes);
+    }
+}
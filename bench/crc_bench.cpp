@@ -0,0 +1,40 @@
+#include "../include/crc32c.h"
+#include "bench.h"
+
+#include <string>
+
+void bench_crc() {
+    std::string data(64 * 1024 * 1024, '\0');
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>(i * 131);
+    }
+    const double bytes = static_cast<double>(data.size());
+
+    bench::report("crc32c software", bench::measure([&] {
+                      bench::keep(~PhPacker::__phpack__detail::php_crc32c_software(
+                          ~0u, data.data(), data.size()));
+                  }),
+                  bytes);
+    bench::report(std::string("crc32c ") + PhPacker::crc32c_kernel(),
+                  bench::measure([&] { bench::keep(PhPacker::crc32c(data)); }),
+                  bytes);
+
+    /* small records, the trailer is computed while they are in cache */
+    const PhPacker::Format format("JNna16");
+    const size_t records = 1 << 20;
+    const double record_bytes = static_cast<double>(records * format.size());
+    bench::report("Format::pack", bench::measure([&] {
+                      for (size_t i = 0; i < records; ++i) {
+                          bench::keep(format.pack(i, 7, 3,
+                                                  std::string_view("user")));
+                      }
+                  }),
+                  record_bytes);
+    bench::report("pack_crc32c", bench::measure([&] {
+                      for (size_t i = 0; i < records; ++i) {
+                          bench::keep(PhPacker::pack_crc32c(
+                              format, 'N', i, 7, 3, std::string_view("user")));
+                      }
+                  }),
+                  record_bytes);
+}
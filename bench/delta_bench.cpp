@@ -0,0 +1,52 @@
+#include "../include/bulk.h"
+#include "../include/delta.h"
+#include "bench.h"
+
+#include <cstdio>
+#include <vector>
+
+void bench_delta() {
+    const size_t n = 8 * 1024 * 1024;
+    std::vector<int64_t> values(n);
+    int64_t t = 1600000000000;
+    for (size_t i = 0; i < n; ++i) {
+        t += 1000 + static_cast<int64_t>(i % 7) - 3;
+        values[i] = t;
+    }
+    const double bytes = static_cast<double>(n * 8);
+    std::vector<int64_t> decoded(n);
+
+    const std::string plain = PhPacker::pack_array('J', values.data(), n);
+    bench::report("unpack_array('J')", bench::measure([&] {
+                      PhPacker::unpack_array('J', plain.data(), n,
+                                             decoded.data());
+                      bench::keep(decoded);
+                  }),
+                  bytes);
+
+    struct Variant {
+        const char *name;
+        PhPacker::DeltaMode mode;
+        char code;
+    };
+    const Variant variants[] = {
+        {"delta varint", PhPacker::DeltaMode::Delta, 0},
+        {"delta 'n'", PhPacker::DeltaMode::Delta, 'n'},
+        {"delta-of-delta varint", PhPacker::DeltaMode::DeltaOfDelta, 0},
+        {"delta-of-delta 'c'", PhPacker::DeltaMode::DeltaOfDelta, 'c'},
+    };
+    for (const Variant &v : variants) {
+        const std::string packed =
+            PhPacker::pack_delta(values.data(), n, v.mode, v.code);
+        const double t_unpack = bench::measure([&] {
+            PhPacker::unpack_delta(packed, n, decoded.data(), v.mode, v.code);
+            bench::keep(decoded);
+        });
+        char ratio[32];
+        std::snprintf(ratio, sizeof(ratio), " (%.1fx smaller)",
+                      bytes / static_cast<double>(packed.size()));
+        /* throughput of the decoded values, like unpack_array above */
+        bench::report(std::string("unpack_delta ") + v.name + ratio, t_unpack,
+                      bytes);
+    }
+}
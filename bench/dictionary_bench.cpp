@@ -0,0 +1,61 @@
+#include "../include/dictionary.h"
+#include "bench.h"
+
+#include <cstdio>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+using Log = std::tuple<uint32_t, std::string, std::string_view, uint16_t>;
+
+} // namespace
+
+void bench_dictionary() {
+    const size_t n = 10 * 1000;
+    const char *const statuses[] = {"ok", "not found", "timeout", "error"};
+    std::vector<Log> logs;
+    for (size_t i = 0; i < n; ++i) {
+        logs.emplace_back(static_cast<uint32_t>(i),
+                          "web-" + std::to_string(i * 7919 % 40) +
+                              ".eu-west.example.com",
+                          statuses[i % 13 % 4], static_cast<uint16_t>(i));
+    }
+
+    /* the same records with fixed width strings */
+    const PhPacker::Format fixed("Na32a16n");
+    std::string fixed_out;
+    const double fixed_time = bench::measure([&] {
+        fixed_out.clear();
+        for (const Log &l : logs) {
+            fixed_out += fixed.pack(std::get<0>(l), std::get<1>(l),
+                                    std::get<2>(l), std::get<3>(l));
+        }
+        bench::keep(fixed_out);
+    });
+    bench::report("Format::pack a32a16 per record", fixed_time,
+                  static_cast<double>(fixed_out.size()));
+
+    const PhPacker::Format indexed("NCCn");
+    PhPacker::StringDictionary dictionary;
+    std::string out;
+    const double dict_time = bench::measure([&] {
+        out = PhPacker::pack_batch(indexed, logs, dictionary);
+        bench::keep(out);
+    });
+    bench::report("pack_batch with dictionary", dict_time,
+                  static_cast<double>(fixed_out.size()));
+
+    std::vector<std::string_view> table;
+    std::vector<Log> decoded;
+    bench::report("unpack_batch with dictionary", bench::measure([&] {
+                      decoded = PhPacker::unpack_batch<Log>(indexed, out,
+                                                            table);
+                      bench::keep(decoded);
+                  }),
+                  static_cast<double>(fixed_out.size()));
+
+    std::printf("%zu records: %zu bytes fixed, %zu with %zu strings\n", n,
+                fixed_out.size(), out.size(), dictionary.size());
+}
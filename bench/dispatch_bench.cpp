@@ -0,0 +1,64 @@
+#include "../include/dispatch.h"
+#include "bench.h"
+
+#include <string>
+#include <vector>
+
+/* every kernel of every ISA this CPU runs, the library uses kernel_isa() */
+void bench_dispatch() {
+    using namespace PhPacker;
+    using __phpack__detail::php_kernels;
+
+    const size_t n = 16 * 1024 * 1024;
+    std::string src(n, '\0');
+    for (size_t i = 0; i < n; ++i) {
+        src[i] = "0123456789abcdef"[(i * 7) % 16];
+    }
+    std::string dst(2 * n, '\0');
+    std::vector<double> doubles(n / 8);
+    for (size_t i = 0; i < doubles.size(); ++i) {
+        doubles[i] = static_cast<double>(i) * 0.37;
+    }
+    std::vector<float> floats(doubles.size());
+    const double bytes = static_cast<double>(n);
+
+    for (Isa isa : {Isa::Scalar, Isa::SSE42, Isa::AVX2, Isa::AVX512,
+                    Isa::ArmV8}) {
+        if (!isa_supported(isa)) {
+            continue;
+        }
+        const php_kernels &k = __phpack__detail::php_kernel_table(isa);
+        const std::string name = std::string(" ") + isa_name(isa);
+        bench::report("bswap64" + name, bench::measure([&] {
+                          k.bswap64(src.data(), n / 8, &dst[0]);
+                          bench::keep(dst);
+                      }),
+                      bytes);
+        bench::report("bswap16" + name, bench::measure([&] {
+                          k.bswap16(src.data(), n / 2, &dst[0]);
+                          bench::keep(dst);
+                      }),
+                      bytes);
+        bench::report("hex_encode" + name, bench::measure([&] {
+                          k.hex_encode(src.data(), 2 * n, &dst[0], true);
+                          bench::keep(dst);
+                      }),
+                      bytes);
+        bench::report("hex_decode" + name, bench::measure([&] {
+                          k.hex_decode(src.data(), n, &dst[0], true);
+                          bench::keep(dst);
+                      }),
+                      bytes);
+        bench::report("f64_to_f32" + name, bench::measure([&] {
+                          k.f64_to_f32(doubles.data(), doubles.size(),
+                                       floats.data());
+                          bench::keep(floats);
+                      }),
+                      bytes);
+        bench::report(std::string("crc32c ") + k.crc32c_name + name,
+                      bench::measure([&] {
+                          bench::keep(k.crc32c(~0u, src.data(), n));
+                      }),
+                      bytes);
+    }
+}
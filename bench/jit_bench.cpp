@@ -0,0 +1,72 @@
+#include "../include/jit.h"
+#include "bench.h"
+
+#include <vector>
+
+/* one record at a time through Format, the interpreter and native code */
+void bench_jit() {
+    using namespace PhPacker;
+    const size_t n = 10 * 1000;
+    const size_t rounds = 100;
+    const Format format("NVnvJlEgCxq");
+    const JitFormat native(format);
+    const JitFormat interpreter(format, false);
+    const size_t size = format.size();
+    const size_t slots = native.slots();
+
+    std::vector<uint64_t> values(n * slots);
+    for (size_t i = 0; i < values.size(); ++i) {
+        values[i] = i * 0x9e3779b97f4a7c15u;
+    }
+    std::string out(n * size, '\0');
+    const double bytes = static_cast<double>(n * rounds * size);
+
+    bench::report("Format::pack_to per record", bench::measure([&] {
+                      for (size_t r = 0; r < rounds; ++r) {
+                          for (size_t i = 0; i < n; ++i) {
+                              const uint64_t *v = &values[i * slots];
+                              format.pack_to(&out[i * size], size, v[0], v[1],
+                                             v[2], v[3], v[4], v[5], 0.5,
+                                             0.25f, v[8], v[9]);
+                          }
+                          bench::keep(out);
+                      }
+                  }),
+                  bytes);
+
+    for (const JitFormat *jit : {&interpreter, &native}) {
+        const char *name = jit->native() ? "native" : "interpreter";
+        bench::report(std::string("encode ") + name, bench::measure([&] {
+                          for (size_t r = 0; r < rounds; ++r) {
+                              for (size_t i = 0; i < n; ++i) {
+                                  jit->encode(&values[i * slots],
+                                              &out[i * size]);
+                              }
+                              bench::keep(out);
+                          }
+                      }),
+                      bytes);
+    }
+
+    bench::report("Format::unpack per record", bench::measure([&] {
+                      for (size_t i = 0; i < n; ++i) {
+                          bench::keep(format.unpack(
+                              std::string_view(&out[i * size], size)));
+                      }
+                  }),
+                  static_cast<double>(n * size));
+
+    for (const JitFormat *jit : {&interpreter, &native}) {
+        const char *name = jit->native() ? "native" : "interpreter";
+        bench::report(std::string("decode ") + name, bench::measure([&] {
+                          for (size_t r = 0; r < rounds; ++r) {
+                              for (size_t i = 0; i < n; ++i) {
+                                  jit->decode(&out[i * size],
+                                              &values[i * slots]);
+                              }
+                              bench::keep(values);
+                          }
+                      }),
+                      bytes);
+    }
+}
@@ -0,0 +1,50 @@
+#include "../include/bulk.h"
+#include "../include/sort_key.h"
+#include "bench.h"
+
+#include <vector>
+
+void bench_key() {
+    const size_t n = 16 * 1024 * 1024;
+    std::vector<int64_t> ints(n);
+    std::vector<double> doubles(n);
+    for (size_t i = 0; i < n; ++i) {
+        ints[i] = static_cast<int64_t>(i * 2654435761u) - (1LL << 40);
+        doubles[i] = static_cast<double>(ints[i]) * 0.001;
+    }
+    std::string out(n * 8, '\0');
+    const double bytes = static_cast<double>(out.size());
+
+    /* plain big endian arrays for reference, they don't sort */
+    bench::report("pack_array('J')", bench::measure([&] {
+                      PhPacker::pack_array('J', ints.data(), n, &out[0]);
+                      bench::keep(out);
+                  }),
+                  bytes);
+
+    bench::report("encode_keys('q')", bench::measure([&] {
+                      PhPacker::encode_keys('q', ints.data(), n, &out[0]);
+                      bench::keep(out);
+                  }),
+                  bytes);
+    std::vector<int64_t> decoded(n);
+    bench::report("decode_keys('q')", bench::measure([&] {
+                      PhPacker::decode_keys('q', out.data(), n,
+                                            decoded.data());
+                      bench::keep(decoded);
+                  }),
+                  bytes);
+
+    bench::report("encode_keys('E')", bench::measure([&] {
+                      PhPacker::encode_keys('E', doubles.data(), n, &out[0]);
+                      bench::keep(out);
+                  }),
+                  bytes);
+    std::vector<double> decoded_doubles(n);
+    bench::report("decode_keys('E')", bench::measure([&] {
+                      PhPacker::decode_keys('E', out.data(), n,
+                                            decoded_doubles.data());
+                      bench::keep(decoded_doubles);
+                  }),
+                  bytes);
+}
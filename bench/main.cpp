@@ -0,0 +1,54 @@
+#include "../include/dispatch.h"
+
+#include <cstdio>
+#include <cstring>
+
+void bench_bulk();
+void bench_delta();
+void bench_key();
+void bench_ring();
+void bench_crc();
+void bench_batch();
+void bench_dispatch();
+void bench_dictionary();
+void bench_jit();
+
+namespace {
+
+struct Benchmark {
+    const char *name;
+    void (*run)();
+};
+
+const Benchmark benchmarks[] = {
+    {"bulk", bench_bulk},
+    {"delta", bench_delta},
+    {"key", bench_key},
+    {"ring", bench_ring},
+    {"crc", bench_crc},
+    {"batch", bench_batch},
+    {"dispatch", bench_dispatch},
+    {"dict", bench_dictionary},
+    {"jit", bench_jit},
+};
+
+} // namespace
+
+/* usage: packbench [name...], runs every benchmark by default */
+int main(int argc, char *argv[]) {
+    /* set PHPACK_ISA=scalar to measure the portable kernels */
+    std::printf("kernels: %s (cpu: %s)\n",
+                PhPacker::isa_name(PhPacker::kernel_isa()),
+                PhPacker::isa_name(PhPacker::cpu_isa()));
+    for (const Benchmark &b : benchmarks) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; ++i) {
+            selected = selected || std::strcmp(argv[i], b.name) == 0;
+        }
+        if (selected) {
+            std::printf("== %s\n", b.name);
+            b.run();
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include "../include/format.h"
+#include "../include/pack_ring.h"
+#include "bench.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const size_t records = 1 << 20;
+const std::string_view user = "audit-user-0001";
+
+/* the old way, a string per record through a locked queue */
+double locked_queue(const PhPacker::Format &format, unsigned producers) {
+    return bench::measure([&] {
+        std::mutex mutex;
+        std::deque<std::string> queue;
+        std::vector<std::thread> threads;
+        for (unsigned p = 0; p < producers; ++p) {
+            threads.emplace_back([&, p] {
+                for (size_t i = p; i < records; i += producers) {
+                    std::string record = format.pack(i, p, user);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    queue.push_back(std::move(record));
+                }
+            });
+        }
+        size_t drained = 0;
+        while (drained < records) {
+            std::deque<std::string> batch;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                batch.swap(queue);
+            }
+            for (const std::string &record : batch) {
+                bench::keep(record);
+            }
+            drained += batch.size();
+            if (batch.empty()) {
+                std::this_thread::yield();
+            }
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+    });
+}
+
+double ring(const PhPacker::Format &format, unsigned producers) {
+    PhPacker::PackRing ring(4096, 64);
+    return bench::measure([&] {
+        std::vector<std::thread> threads;
+        for (unsigned p = 0; p < producers; ++p) {
+            threads.emplace_back([&, p] {
+                for (size_t i = p; i < records; i += producers) {
+                    ring.pack(format, i, p, user);
+                }
+            });
+        }
+        size_t drained = 0;
+        while (drained < records) {
+            const size_t n =
+                ring.drain([](std::string_view record) { bench::keep(record); });
+            drained += n;
+            if (n == 0) {
+                std::this_thread::yield();
+            }
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+    });
+}
+
+} // namespace
+
+void bench_ring() {
+    const PhPacker::Format format("JNa16");
+    const double bytes = static_cast<double>(records * format.size());
+    for (unsigned producers = 1; producers <= 64; producers *= 2) {
+        const std::string n = " x" + std::to_string(producers);
+        bench::report("mutex queue" + n, locked_queue(format, producers),
+                      bytes);
+        bench::report("PackRing" + n, ring(format, producers), bytes);
+    }
+}
@@ -0,0 +1,24 @@
+set(PHPACK_INCLUDE_DIR ${CMAKE_CURRENT_LIST_DIR}/../include)
+
+# phpack_generate(<target> <schema>)
+#
+# Runs phpack_gen on <schema> at build time and adds the generated header,
+# named after the schema, to <target>'s sources and include path.
+function(phpack_generate target schema)
+  get_filename_component(schema_path ${schema} ABSOLUTE)
+  get_filename_component(schema_name ${schema} NAME_WE)
+
+  set(output_dir ${CMAKE_CURRENT_BINARY_DIR}/phpack_generated)
+  set(output ${output_dir}/${schema_name}.h)
+
+  add_custom_command(
+    OUTPUT ${output}
+    COMMAND ${CMAKE_COMMAND} -E make_directory ${output_dir}
+    COMMAND phpack_gen ${schema_path} ${output}
+    DEPENDS phpack_gen ${schema_path}
+    COMMENT "Generating ${schema_name}.h from ${schema}")
+
+  target_sources(${target} PRIVATE ${output})
+  target_include_directories(${target} PRIVATE ${output_dir}
+                                               ${PHPACK_INCLUDE_DIR})
+endfunction()
@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "batch.h"
+
+namespace PhPacker {
+
+namespace __phpack__detail {
+
+std::vector<const FormatField *>
+php_batch_fields(const Format &format, size_t arity, const bool *strings,
+                 const char *caller) {
+    if (!format.fixed() || format.size() == 0) {
+        throw std::invalid_argument(std::string(caller) + ": format \"" +
+                                    format.str() + "\" has no fixed size");
+    }
+    std::vector<const FormatField *> fields;
+    for (const FormatField &field : format.fields()) {
+        if (!field.takes_value()) {
+            continue;
+        }
+        const bool numeric = !field.is_string() && !field.is_bits() &&
+                             php_array_dispatch(field.code, [](auto) {});
+        if (!numeric) {
+            throw std::invalid_argument(
+                php_type_error(field.code, std::string(caller) +
+                                               " takes numeric fields only"));
+        }
+        if (fields.size() < arity && strings[fields.size()] &&
+            php_pack_code_is_float(field.code)) {
+            throw std::invalid_argument(php_type_error(
+                field.code, "string members need an integer index code"));
+        }
+        fields.push_back(&field);
+    }
+    if (fields.size() != arity) {
+        throw std::invalid_argument(
+            std::string(caller) + ": format \"" + format.str() + "\" has " +
+            std::to_string(fields.size()) + " values, records have " +
+            std::to_string(arity));
+    }
+    return fields;
+}
+
+} // namespace __phpack__detail
+
+} // namespace PhPacker
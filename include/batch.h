@@ -0,0 +1,373 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "bulk.h"
+#include "format.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace PhPacker {
+
+namespace __phpack__detail {
+
+template <typename R, typename = void>
+struct php_is_tuple_like : std::false_type {};
+
+template <typename R>
+struct php_is_tuple_like<R, std::void_t<decltype(std::tuple_size<R>::value)>>
+    : std::true_type {};
+
+/* the fields of a record as something std::get works on. Structs provide
+ * phpack_tie(R &), found by ADL, which only reads them while packing */
+template <typename R> decltype(auto) php_batch_tie(R &record) {
+    using Plain = std::remove_const_t<R>;
+    if constexpr (php_is_tuple_like<Plain>::value) {
+        return (record);
+    } else {
+        return phpack_tie(const_cast<Plain &>(record));
+    }
+}
+
+template <typename R>
+using php_batch_tuple_t = std::remove_reference_t<decltype(php_batch_tie(
+    std::declval<std::remove_const_t<R> &>()))>;
+
+template <size_t J, typename R>
+using php_batch_value_t = std::remove_cv_t<std::remove_reference_t<
+    std::tuple_element_t<J, php_batch_tuple_t<R>>>>;
+
+template <typename R>
+constexpr size_t php_batch_arity = std::tuple_size<php_batch_tuple_t<R>>::value;
+
+/* string members are packed as an index into a StringDictionary */
+template <typename T>
+constexpr bool php_batch_is_string = std::is_same<T, std::string>::value ||
+                                     std::is_same<T, std::string_view>::value;
+
+template <typename R, size_t... J>
+constexpr std::array<bool, sizeof...(J)>
+php_batch_strings(std::index_sequence<J...>) noexcept {
+    return {{php_batch_is_string<php_batch_value_t<J, R>>...}};
+}
+
+/* the dictionary of pack_batch() calls without one */
+struct php_no_dictionary {};
+
+/* the value fields of format, one per record member, strings[j] if
+ * member j is a string
+ * @throw std::invalid_argument unless format is fixed and numeric and
+ * string members have integer codes */
+std::vector<const FormatField *>
+php_batch_fields(const Format &format, size_t arity, const bool *strings,
+                 const char *caller);
+
+template <typename R>
+std::vector<const FormatField *> php_batch_fields(const Format &format,
+                                                  const char *caller) {
+    constexpr size_t arity = php_batch_arity<R>;
+    constexpr std::array<bool, arity> strings =
+        php_batch_strings<R>(std::make_index_sequence<arity>());
+    return php_batch_fields(format, arity, strings.data(), caller);
+}
+
+/* bytes of output a tile of records covers, sized to stay in L1 while
+ * every field is written into it */
+constexpr size_t php_batch_tile_bytes = 16 * 1024;
+
+inline size_t php_batch_tile(const Format &format) noexcept {
+    return std::max<size_t>(1, php_batch_tile_bytes / format.size());
+}
+
+/* index of the first of n records whose member J doesn't fit, n if all do */
+template <char Code, size_t J, typename R>
+size_t php_batch_misfit(const R *records, size_t n) noexcept {
+    using T = php_batch_value_t<J, R>;
+    if constexpr (!php_batch_is_string<T>) {
+        for (size_t i = 0; i < n; ++i) {
+            if (!php_fits<Code>(T(std::get<J>(php_batch_tie(records[i]))))) {
+                return i;
+            }
+        }
+    }
+    /* string indexes are checked as they are assigned */
+    return n;
+}
+
+/* stores the dictionary indexes of string member J */
+template <char Code, size_t J, typename R, typename Dict>
+void php_batch_store_index(const R *records, size_t n, char *out,
+                           size_t stride, Dict *dictionary, size_t first) {
+    static_assert(!std::is_same<Dict, php_no_dictionary>::value,
+                  "pack_batch: string members need a StringDictionary");
+    constexpr uint64_t max = php_code_hi<Code, uint64_t>();
+    for (size_t i = 0; i < n; ++i, out += stride) {
+        const size_t index = dictionary->add(
+            std::string_view(std::get<J>(php_batch_tie(records[i]))));
+        if (index > max) {
+            throw RangeError(Code, first + i);
+        }
+        php_pack_value<Code>(static_cast<uint64_t>(index), out);
+    }
+}
+
+/* stores member J of n records into the field at out, stride apart */
+template <char Code, size_t J, typename R, typename Dict>
+void php_batch_store(const R *records, size_t n, char *out, size_t stride,
+                     bool saturate, Dict *dictionary, size_t first) {
+    using T = php_batch_value_t<J, R>;
+    if constexpr (php_batch_is_string<T>) {
+        php_batch_store_index<Code, J>(records, n, out, stride, dictionary,
+                                       first);
+    } else {
+        static_assert(std::is_arithmetic<T>::value,
+                      "pack_batch: record members must be arithmetic");
+        if (saturate) {
+            for (size_t i = 0; i < n; ++i, out += stride) {
+                const T v = std::get<J>(php_batch_tie(records[i]));
+                php_pack_value<Code>(php_saturate<Code>(v), out);
+            }
+            return;
+        }
+        for (size_t i = 0; i < n; ++i, out += stride) {
+            php_pack_value<Code>(T(std::get<J>(php_batch_tie(records[i]))),
+                                 out);
+        }
+    }
+}
+
+template <char Code, size_t J, typename R>
+void php_batch_load(const char *data, size_t n, size_t stride, R *records,
+                    const std::vector<std::string_view> *table) {
+    using T = php_batch_value_t<J, R>;
+    if constexpr (php_batch_is_string<T>) {
+        if (!table) {
+            throw std::invalid_argument(
+                "unpack_batch: string members need a dictionary table");
+        }
+        for (size_t i = 0; i < n; ++i, data += stride) {
+            const auto index = php_unpack_value<Code, uint64_t>(data);
+            if (index >= table->size()) {
+                throw std::out_of_range("unpack_batch: index " +
+                                        std::to_string(index) +
+                                        " beyond the dictionary");
+            }
+            std::get<J>(php_batch_tie(records[i])) =
+                T((*table)[php_narrow<size_t>(index)]);
+        }
+    } else {
+        static_assert(std::is_arithmetic<T>::value,
+                      "unpack_batch: record members must be arithmetic");
+        for (size_t i = 0; i < n; ++i, data += stride) {
+            std::get<J>(php_batch_tie(records[i])) =
+                php_unpack_value<Code, T>(data);
+        }
+    }
+}
+
+/* throws for the first record of the tile with a member that doesn't fit */
+template <typename R, size_t... J>
+void php_check_tile(const FormatField *const *fields, const R *records,
+                    size_t n, size_t first, std::index_sequence<J...>) {
+    size_t misfit = n;
+    char code = 0;
+    const auto check = [&](const FormatField *field, auto c, auto j) {
+        const size_t i =
+            php_batch_misfit<decltype(c)::value, decltype(j)::value>(records,
+                                                                     misfit);
+        if (i < misfit) {
+            misfit = i;
+            code = field->code;
+        }
+    };
+    (php_array_dispatch(fields[J]->code,
+                        [&](auto c) {
+                            check(fields[J], c,
+                                  std::integral_constant<size_t, J>());
+                        }),
+     ...);
+    if (misfit != n) {
+        throw RangeError(code, first + misfit);
+    }
+}
+
+template <typename R, typename Dict, size_t... J>
+void php_pack_tile(const FormatField *const *fields, const R *records,
+                   size_t n, char *out, size_t stride, bool saturate,
+                   Dict *dictionary, size_t first, std::index_sequence<J...>) {
+    (php_array_dispatch(fields[J]->code,
+                        [&](auto c) {
+                            php_batch_store<decltype(c)::value, J>(
+                                records, n, out + fields[J]->offset, stride,
+                                saturate, dictionary, first);
+                        }),
+     ...);
+}
+
+template <typename R, size_t... J>
+void php_unpack_tile(const FormatField *const *fields, const char *data,
+                     size_t n, size_t stride, R *records,
+                     const std::vector<std::string_view> *table,
+                     std::index_sequence<J...>) {
+    (php_array_dispatch(fields[J]->code,
+                        [&](auto c) {
+                            php_batch_load<decltype(c)::value, J>(
+                                data + fields[J]->offset, n, stride, records,
+                                table);
+                        }),
+     ...);
+}
+
+template <typename R, typename Dict>
+void php_pack_batch(const Format &format, const R *records, size_t n,
+                    char *out, Dict *dictionary) {
+    constexpr size_t arity = php_batch_arity<R>;
+    const std::vector<const FormatField *> fields =
+        php_batch_fields<R>(format, "pack_batch");
+    const size_t stride = format.size();
+    const size_t tile = php_batch_tile(format);
+    const bool padded = fields.size() != format.fields().size();
+    for (size_t first = 0; first < n; first += tile) {
+        const size_t m = std::min(tile, n - first);
+        char *dst = out + first * stride;
+        if (format.conversion() == Conversion::Check) {
+            php_check_tile(fields.data(), records + first, m, first,
+                           std::make_index_sequence<arity>());
+        }
+        if (padded) {
+            memset(dst, 0, m * stride);
+        }
+        php_pack_tile(fields.data(), records + first, m, dst, stride,
+                      format.conversion() == Conversion::Saturate,
+                      dictionary, first, std::make_index_sequence<arity>());
+    }
+}
+
+template <typename R>
+void php_unpack_batch(const Format &format, std::string_view data,
+                      R *records, size_t n,
+                      const std::vector<std::string_view> *table) {
+    constexpr size_t arity = php_batch_arity<R>;
+    const std::vector<const FormatField *> fields =
+        php_batch_fields<R>(format, "unpack_batch");
+    const size_t stride = format.size();
+    if (data.size() / stride < n) {
+        throw std::out_of_range("unpack_batch: data too short for " +
+                                std::to_string(n) + " records");
+    }
+    const size_t tile = php_batch_tile(format);
+    for (size_t first = 0; first < n; first += tile) {
+        php_unpack_tile(fields.data(), data.data() + first * stride,
+                        std::min(tile, n - first), stride, records + first,
+                        table, std::make_index_sequence<arity>());
+    }
+}
+
+} // namespace __phpack__detail
+
+/**
+ * @brief pack n records with a fixed, numeric format
+ *
+ * Records are tuple-like (std::tuple, std::pair, std::array) or structs
+ * with a phpack_tie() overload found by ADL:
+ *
+ *     auto phpack_tie(Point &p) { return std::tie(p.x, p.y); }
+ *
+ * Member J is packed by the J-th field that takes a value. The output is
+ * the same as packing every record in turn, but the records are walked
+ * in tiles of a few KiB of output, and within a tile one field at a time,
+ * so each field's code is resolved once per tile and its loop is a
+ * straight strided store. String members need the StringDictionary
+ * overloads of dictionary.h.
+ *
+ * @param out room for n * format.size() bytes
+ * @throw std::invalid_argument if the format has string, bit or '*'
+ * fields or its value count differs from the record's
+ * @throw RangeError with the index of the first record that doesn't fit,
+ * for Conversion::Check. Tiles are checked before they are packed, so
+ * the records of earlier tiles are already packed.
+ */
+template <typename R>
+void pack_batch(const Format &format, const R *records, size_t n, char *out) {
+    using namespace __phpack__detail;
+    php_pack_batch(format, records, n, out,
+                   static_cast<php_no_dictionary *>(nullptr));
+}
+
+/**
+ * @brief pack_batch into a string allocated once
+ */
+template <typename R>
+std::string pack_batch(const Format &format, const R *records, size_t n) {
+    std::string output(n * format.size(), '\0');
+    pack_batch(format, records, n, &output[0]);
+    return output;
+}
+
+template <typename R>
+std::string pack_batch(const Format &format, const std::vector<R> &records) {
+    return pack_batch(format, records.data(), records.size());
+}
+
+/**
+ * @brief unpack n records packed with a fixed, numeric format, the
+ * inverse of pack_batch
+ * @param data at least n * format.size() bytes
+ * @throw std::invalid_argument as pack_batch
+ * @throw std::out_of_range if data is too short
+ */
+template <typename R>
+void unpack_batch(const Format &format, std::string_view data, R *records,
+                  size_t n) {
+    __phpack__detail::php_unpack_batch(format, data, records, n, nullptr);
+}
+
+/**
+ * @brief unpack every whole record in data
+ */
+template <typename R>
+std::vector<R> unpack_batch(const Format &format, std::string_view data) {
+    std::vector<R> records(format.size() ? data.size() / format.size() : 0);
+    unpack_batch(format, data, records.data(), records.size());
+    return records;
+}
+
+} // namespace PhPacker
+
+#endif /* BATCH_H */
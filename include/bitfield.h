@@ -0,0 +1,184 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef BITFIELD_H
+#define BITFIELD_H
+
+#include "pack.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace PhPacker {
+
+/**
+ * @brief Order of the fields inside a group of bit fields
+ *
+ * MsbFirst puts the first field in the most significant bits and stores
+ * the group big endian, so it reads left to right like a wire diagram.
+ * LsbFirst puts the first field in bit 0 and stores the group little
+ * endian. Unused bits at the end of the last byte are zero.
+ */
+enum class BitOrder { MsbFirst, LsbFirst };
+
+namespace __phpack__detail {
+
+constexpr uint64_t php_bit_mask(unsigned width) noexcept {
+    return width >= 64 ? ~uint64_t{0} : (uint64_t{1} << width) - 1;
+}
+
+/* bit position of a field that follows `before` bits in a group */
+constexpr unsigned php_bit_shift(BitOrder order, unsigned before,
+                                 unsigned width, size_t bytes) noexcept {
+    return order == BitOrder::MsbFirst
+               ? static_cast<unsigned>(bytes * 8) - before - width
+               : before;
+}
+
+template <BitOrder Order, unsigned... Widths>
+constexpr std::array<unsigned, sizeof...(Widths)> php_bit_shifts() noexcept {
+    constexpr unsigned widths[] = {Widths...};
+    constexpr size_t bytes = ((0u + ... + Widths) + 7) / 8;
+    std::array<unsigned, sizeof...(Widths)> shifts{};
+    unsigned before = 0;
+    for (size_t i = 0; i < sizeof...(Widths); ++i) {
+        shifts[i] = php_bit_shift(Order, before, widths[i], bytes);
+        before += widths[i];
+    }
+    return shifts;
+}
+
+/* runtime sized versions of php_load_uint/php_store_uint */
+inline uint64_t php_load_bytes(const char *src, size_t size,
+                               bool little) noexcept {
+    uint64_t v = 0;
+    for (size_t i = 0; i < size; ++i) {
+        v |= static_cast<uint64_t>(
+                 static_cast<unsigned char>(src[little ? i : size - 1 - i]))
+             << (8 * i);
+    }
+    return v;
+}
+
+inline void php_store_bytes(uint64_t v, size_t size, bool little,
+                            char *dst) noexcept {
+    for (size_t i = 0; i < size; ++i) {
+        dst[little ? i : size - 1 - i] =
+            static_cast<char>(static_cast<unsigned char>(v >> (8 * i)));
+    }
+}
+
+} // namespace __phpack__detail
+
+/**
+ * @brief A record of bit fields, e.g. BitFields<BitOrder::MsbFirst, 3, 12, 1>
+ *
+ * Shifts and masks are computed at compile time, a record is at most 64
+ * bits and is packed into size bytes.
+ */
+template <BitOrder Order, unsigned... Widths> class BitFields {
+  public:
+    static constexpr size_t count = sizeof...(Widths);
+    static constexpr unsigned bits = (0u + ... + Widths);
+    static constexpr size_t size = (bits + 7) / 8;
+
+    static_assert(count > 0, "at least one bit field is required");
+    static_assert(((Widths > 0) && ...), "bit fields can not be empty");
+    static_assert(bits <= 64, "bit fields are limited to 64 bits");
+
+    static constexpr std::array<unsigned, count> widths = {Widths...};
+    static constexpr std::array<unsigned, count> shifts =
+        __phpack__detail::php_bit_shifts<Order, Widths...>();
+    static constexpr std::array<uint64_t, count> masks = {
+        __phpack__detail::php_bit_mask(Widths)...};
+
+    using values = std::array<uint64_t, count>;
+
+    template <size_t I> static constexpr uint64_t get(uint64_t word) noexcept {
+        return (word >> shifts[I]) & masks[I];
+    }
+
+    /* values wider than their field are truncated */
+    static constexpr uint64_t encode(const values &v) noexcept {
+        return encode(v, std::make_index_sequence<count>());
+    }
+
+    static constexpr values decode(uint64_t word) noexcept {
+        return decode(word, std::make_index_sequence<count>());
+    }
+
+    static void pack(const values &v, char *dst) noexcept {
+        __phpack__detail::php_store_uint<size, little>(encode(v), dst);
+    }
+
+    static values unpack(const char *src) noexcept {
+        return decode(__phpack__detail::php_load_uint<size, little>(src));
+    }
+
+    /**
+     * @brief pack n records into n * size bytes
+     */
+    static void pack_array(const values *records, size_t n,
+                           char *out) noexcept {
+        for (size_t i = 0; i < n; ++i, out += size) {
+            pack(records[i], out);
+        }
+    }
+
+    /**
+     * @brief unpack n records, every field is a constant shift and mask of
+     * the record's word so the loop has no branches
+     */
+    static void unpack_array(const char *data, size_t n,
+                             values *out) noexcept {
+        for (size_t i = 0; i < n; ++i, data += size) {
+            out[i] = unpack(data);
+        }
+    }
+
+  private:
+    static constexpr bool little = Order == BitOrder::LsbFirst;
+
+    template <size_t... I>
+    static constexpr uint64_t encode(const values &v,
+                                     std::index_sequence<I...>) noexcept {
+        return (0 | ... | ((v[I] & masks[I]) << shifts[I]));
+    }
+
+    template <size_t... I>
+    static constexpr values decode(uint64_t word,
+                                   std::index_sequence<I...>) noexcept {
+        return {{get<I>(word)...}};
+    }
+};
+
+} // namespace PhPacker
+
+#endif /* BITFIELD_H */
@@ -0,0 +1,579 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef BULK_H
+#define BULK_H
+
+#include "dispatch.h"
+#include "pack.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace PhPacker {
+
+namespace __phpack__detail {
+
+template <char Code, typename T>
+void php_pack_value(const T value, char *out) noexcept {
+    constexpr size_t size = php_pack_code_size(Code);
+    constexpr bool little = php_code_is_little(Code);
+
+    if constexpr (Code == 'f' || Code == 'g' || Code == 'G') {
+        const float f = static_cast<float>(value);
+        uint32_t bits{};
+        memcpy(&bits, &f, sizeof(float));
+        php_store_uint<size, little>(bits, out);
+    } else if constexpr (Code == 'd' || Code == 'e' || Code == 'E') {
+        const double d = static_cast<double>(value);
+        uint64_t bits{};
+        memcpy(&bits, &d, sizeof(double));
+        php_store_uint<size, little>(bits, out);
+    } else if constexpr (std::is_floating_point<T>::value) {
+        php_store_uint<size, little>(
+            php_double_to_uint(static_cast<double>(value)), out);
+    } else {
+        php_store_uint<size, little>(static_cast<uint64_t>(value), out);
+    }
+}
+
+template <char Code, typename T> T php_unpack_value(const char *data) noexcept {
+    constexpr size_t size = php_pack_code_size(Code);
+    constexpr bool little = php_code_is_little(Code);
+
+    const uint64_t v = php_load_uint<size, little>(data);
+    if constexpr (Code == 'f' || Code == 'g' || Code == 'G') {
+        const uint32_t bits = static_cast<uint32_t>(v);
+        float f{};
+        memcpy(&f, &bits, sizeof(float));
+        return static_cast<T>(f);
+    } else if constexpr (Code == 'd' || Code == 'e' || Code == 'E') {
+        double d{};
+        memcpy(&d, &v, sizeof(double));
+        return static_cast<T>(d);
+    } else if constexpr (Code == 'c') {
+        return static_cast<T>(static_cast<signed char>(v));
+    } else if constexpr (Code == 's') {
+        return static_cast<T>(static_cast<int16_t>(v));
+    } else if constexpr (Code == 'i') {
+        return static_cast<T>(static_cast<int>(v));
+    } else if constexpr (Code == 'l') {
+        return static_cast<T>(static_cast<int32_t>(v));
+    } else if constexpr (Code == 'q') {
+        return static_cast<T>(static_cast<int64_t>(v));
+    } else {
+        return static_cast<T>(v);
+    }
+}
+
+/* true if a T holds the bytes code packs, so arrays are copied or byte
+ * swapped as a whole */
+template <char Code, typename T> constexpr bool php_same_layout() noexcept {
+    if constexpr (sizeof(T) != php_pack_code_size(Code)) {
+        return false;
+    } else if constexpr (Code == 'f' || Code == 'g' || Code == 'G') {
+        return std::is_same<T, float>::value;
+    } else if constexpr (Code == 'd' || Code == 'e' || Code == 'E') {
+        return std::is_same<T, double>::value;
+    } else {
+        return std::is_integral<T>::value && !std::is_same<T, bool>::value;
+    }
+}
+
+template <char Code, typename T>
+constexpr bool php_float_of_double() noexcept {
+    return (Code == 'f' || Code == 'g' || Code == 'G') &&
+           std::is_same<T, double>::value;
+}
+
+/* arrays that match the code go through the kernels of kernel_isa() */
+template <char Code, typename T>
+void php_pack_array(const T *values, size_t n, char *out) noexcept {
+    constexpr size_t size = php_pack_code_size(Code);
+    constexpr bool little = php_code_is_little(Code);
+    if constexpr (php_same_layout<Code, T>()) {
+        php_store_array<size, little>(values, n, out);
+    } else if constexpr (php_float_of_double<Code, T>()) {
+        constexpr size_t block = 256;
+        float narrowed[block];
+        const php_kernels &kernels = php_kernel_table();
+        for (size_t start = 0; start < n; start += block) {
+            const size_t m = std::min(block, n - start);
+            kernels.f64_to_f32(values + start, m, narrowed);
+            php_store_array<size, little>(narrowed, m, out + start * size);
+        }
+    } else {
+        for (size_t i = 0; i < n; ++i, out += size) {
+            php_pack_value<Code>(values[i], out);
+        }
+    }
+}
+
+template <char Code, typename T>
+void php_unpack_array(const char *data, size_t n, T *out) noexcept {
+    constexpr size_t size = php_pack_code_size(Code);
+    constexpr bool little = php_code_is_little(Code);
+    if constexpr (php_same_layout<Code, T>()) {
+        php_load_array<size, little>(data, n, out);
+    } else if constexpr (php_float_of_double<Code, T>()) {
+        constexpr size_t block = 256;
+        float narrow[block];
+        const php_kernels &kernels = php_kernel_table();
+        for (size_t start = 0; start < n; start += block) {
+            const size_t m = std::min(block, n - start);
+            php_load_array<size, little>(data + start * size, m, narrow);
+            kernels.f32_to_f64(narrow, m, out + start);
+        }
+    } else {
+        for (size_t i = 0; i < n; ++i, data += size) {
+            out[i] = php_unpack_value<Code, T>(data);
+        }
+    }
+}
+
+constexpr double php_pow2(unsigned e) noexcept {
+    double p = 1;
+    for (unsigned i = 0; i < e; ++i) {
+        p *= 2;
+    }
+    return p;
+}
+
+/* the values of T an integer code holds, lo <= v <= hi for integral T and
+ * lo <= v < hi for floating point T */
+template <char Code, typename T> constexpr T php_code_lo() noexcept {
+    constexpr unsigned bits = php_pack_code_size(Code) * 8;
+    if constexpr (!php_code_is_signed(Code)) {
+        return T(0);
+    } else if constexpr (std::is_floating_point<T>::value) {
+        return static_cast<T>(-php_pow2(bits - 1));
+    } else if constexpr (!std::is_signed<T>::value ||
+                         bits > std::numeric_limits<T>::digits) {
+        return std::numeric_limits<T>::min();
+    } else {
+        return static_cast<T>(-(int64_t{1} << (bits - 1)));
+    }
+}
+
+template <char Code, typename T> constexpr T php_code_hi() noexcept {
+    constexpr unsigned bits = php_pack_code_size(Code) * 8;
+    constexpr unsigned digits = php_code_is_signed(Code) ? bits - 1 : bits;
+    if constexpr (std::is_floating_point<T>::value) {
+        return static_cast<T>(php_pow2(digits));
+    } else if constexpr (digits >= std::numeric_limits<T>::digits) {
+        return std::numeric_limits<T>::max();
+    } else {
+        return static_cast<T>((uint64_t{1} << digits) - 1);
+    }
+}
+
+template <char Code, typename T> bool php_fits(T v) noexcept {
+    if constexpr (Code == 'f' || Code == 'g' || Code == 'G') {
+        /* only finite doubles beyond the float range */
+        if constexpr (sizeof(T) > sizeof(float) &&
+                      std::is_floating_point<T>::value) {
+            constexpr T max = std::numeric_limits<float>::max();
+            return !(v > max || v < -max) ||
+                   v == std::numeric_limits<T>::infinity() ||
+                   v == -std::numeric_limits<T>::infinity();
+        } else {
+            return true;
+        }
+    } else if constexpr (php_pack_code_is_float(Code)) {
+        return true;
+    } else if constexpr (std::is_floating_point<T>::value) {
+        return (v >= php_code_lo<Code, T>()) & (v < php_code_hi<Code, T>());
+    } else {
+        bool fits = true;
+        if constexpr (php_code_lo<Code, T>() !=
+                      std::numeric_limits<T>::min()) {
+            fits &= v >= php_code_lo<Code, T>();
+        }
+        if constexpr (php_code_hi<Code, T>() !=
+                      std::numeric_limits<T>::max()) {
+            fits &= v <= php_code_hi<Code, T>();
+        }
+        return fits;
+    }
+}
+
+/* index of the first value that doesn't fit code, n if all do. Whole
+ * blocks are tested without branches, so the common case vectorizes */
+template <char Code, typename T>
+size_t php_find_misfit(const T *values, size_t n) noexcept {
+    constexpr size_t block = 1024;
+    for (size_t start = 0; start < n; start += block) {
+        const size_t end = std::min(n, start + block);
+        /* an integer, bool reductions don't vectorize */
+        unsigned misfits = 0;
+        for (size_t i = start; i < end; ++i) {
+            misfits |= static_cast<unsigned>(!php_fits<Code>(values[i]));
+        }
+        if (misfits) {
+            for (size_t i = start; i < end; ++i) {
+                if (!php_fits<Code>(values[i])) {
+                    return i;
+                }
+            }
+        }
+    }
+    return n;
+}
+
+/* a value clamped to what code holds, as the type php_pack_array stores */
+template <char Code, typename T> auto php_saturate(T v) noexcept {
+    if constexpr (Code == 'f' || Code == 'g' || Code == 'G') {
+        if constexpr (std::is_floating_point<T>::value) {
+            constexpr T max = std::numeric_limits<float>::max();
+            return php_fits<Code>(v) ? v : v > 0 ? max : -max;
+        } else {
+            return v;
+        }
+    } else if constexpr (php_pack_code_is_float(Code)) {
+        return v;
+    } else if constexpr (std::is_floating_point<T>::value) {
+        using I = std::conditional_t<php_code_is_signed(Code), int64_t,
+                                     uint64_t>;
+        constexpr I lo = php_code_lo<Code, I>();
+        constexpr I hi = php_code_hi<Code, I>();
+        if (v != v) {
+            return I(0);
+        }
+        return v < php_code_lo<Code, T>()    ? lo
+               : v >= php_code_hi<Code, T>() ? hi
+                                             : static_cast<I>(v);
+    } else {
+        return std::min(std::max(v, php_code_lo<Code, T>()),
+                        php_code_hi<Code, T>());
+    }
+}
+
+template <char Code, typename T>
+void php_pack_array(const T *values, size_t n, char *out,
+                    Conversion conversion) {
+    constexpr size_t size = php_pack_code_size(Code);
+    if (conversion == Conversion::Check) {
+        /* test a block while it is in cache, then pack it */
+        constexpr size_t block = 4096;
+        for (size_t start = 0; start < n; start += block) {
+            const size_t m = std::min(block, n - start);
+            const size_t i = php_find_misfit<Code>(values + start, m);
+            if (i != m) {
+                throw RangeError(Code, start + i);
+            }
+            php_pack_array<Code>(values + start, m, out + start * size);
+        }
+        return;
+    }
+    if (conversion != Conversion::Saturate) {
+        php_pack_array<Code>(values, n, out);
+        return;
+    }
+
+    constexpr size_t block = 256;
+    decltype(php_saturate<Code>(T{})) clamped[block];
+    for (size_t start = 0; start < n; start += block) {
+        const size_t m = std::min(block, n - start);
+        for (size_t i = 0; i < m; ++i) {
+            clamped[i] = php_saturate<Code>(values[start + i]);
+        }
+        php_pack_array<Code>(clamped, m, out + start * size);
+    }
+}
+
+/* calls f with the array kernel of code as a template argument */
+template <typename F> bool php_array_dispatch(char code, F &&f) {
+    switch (code) {
+    case 'c':
+        f(std::integral_constant<char, 'c'>());
+        return true;
+    case 'C':
+        f(std::integral_constant<char, 'C'>());
+        return true;
+    case 's':
+        f(std::integral_constant<char, 's'>());
+        return true;
+    case 'S':
+        f(std::integral_constant<char, 'S'>());
+        return true;
+    case 'n':
+        f(std::integral_constant<char, 'n'>());
+        return true;
+    case 'v':
+        f(std::integral_constant<char, 'v'>());
+        return true;
+    case 'i':
+        f(std::integral_constant<char, 'i'>());
+        return true;
+    case 'I':
+        f(std::integral_constant<char, 'I'>());
+        return true;
+    case 'l':
+        f(std::integral_constant<char, 'l'>());
+        return true;
+    case 'L':
+        f(std::integral_constant<char, 'L'>());
+        return true;
+    case 'N':
+        f(std::integral_constant<char, 'N'>());
+        return true;
+    case 'V':
+        f(std::integral_constant<char, 'V'>());
+        return true;
+#if SIZEOF_LONG > 4
+    case 'q':
+        f(std::integral_constant<char, 'q'>());
+        return true;
+    case 'Q':
+        f(std::integral_constant<char, 'Q'>());
+        return true;
+    case 'J':
+        f(std::integral_constant<char, 'J'>());
+        return true;
+    case 'P':
+        f(std::integral_constant<char, 'P'>());
+        return true;
+#endif
+    case 'f':
+        f(std::integral_constant<char, 'f'>());
+        return true;
+    case 'g':
+        f(std::integral_constant<char, 'g'>());
+        return true;
+    case 'G':
+        f(std::integral_constant<char, 'G'>());
+        return true;
+    case 'd':
+        f(std::integral_constant<char, 'd'>());
+        return true;
+    case 'e':
+        f(std::integral_constant<char, 'e'>());
+        return true;
+    case 'E':
+        f(std::integral_constant<char, 'E'>());
+        return true;
+    }
+    return false;
+}
+
+inline size_t php_array_code_size(char code) {
+    const size_t size = php_pack_code_size(code);
+    if (size == 0) {
+        throw std::invalid_argument(std::string("Type ") + code +
+                                    ": not a fixed width code");
+    }
+    return size;
+}
+
+} // namespace __phpack__detail
+
+/**
+ * @brief pack an array of values with one fixed width code
+ * @param code a numeric code
+ * @param values
+ * @param n
+ * @param out room for n * php_pack_code_size(code) bytes
+ * @throw std::invalid_argument if code is not numeric
+ */
+template <typename T,
+          typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+void pack_array(char code, const T *values, size_t n, char *out) {
+    using namespace __phpack__detail;
+    php_array_code_size(code);
+    php_array_dispatch(code, [&](auto c) {
+        php_pack_array<decltype(c)::value>(values, n, out);
+    });
+}
+
+template <typename T,
+          typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+std::string pack_array(char code, const T *values, size_t n) {
+    std::string output(n * __phpack__detail::php_array_code_size(code), '\0');
+    pack_array(code, values, n, &output[0]);
+    return output;
+}
+
+/**
+ * @brief pack an array with a conversion for values that don't fit code
+ *
+ * Check tests each block before packing it, Saturate clamps blocks into
+ * a small buffer first. Both loops are branch free.
+ *
+ * @throw RangeError with the index of the first value that doesn't fit,
+ * for Conversion::Check. The blocks before it are already packed.
+ */
+template <typename T,
+          typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+void pack_array(char code, const T *values, size_t n, char *out,
+                Conversion conversion) {
+    using namespace __phpack__detail;
+    php_array_code_size(code);
+    php_array_dispatch(code, [&](auto c) {
+        php_pack_array<decltype(c)::value>(values, n, out, conversion);
+    });
+}
+
+template <typename T,
+          typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+std::string pack_array(char code, const T *values, size_t n,
+                       Conversion conversion) {
+    std::string output(n * __phpack__detail::php_array_code_size(code), '\0');
+    pack_array(code, values, n, &output[0], conversion);
+    return output;
+}
+
+/**
+ * @brief unpack n values packed with one fixed width code
+ * @param code a numeric code
+ * @param data at least n * php_pack_code_size(code) bytes
+ * @param n
+ * @param out
+ * @throw std::invalid_argument if code is not numeric
+ */
+template <typename T,
+          typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+void unpack_array(char code, const char *data, size_t n, T *out) {
+    using namespace __phpack__detail;
+    php_array_code_size(code);
+    php_array_dispatch(code, [&](auto c) {
+        php_unpack_array<decltype(c)::value>(data, n, out);
+    });
+}
+
+/**
+ * @brief Runs each task on a new thread, the default for
+ * pack_array_parallel
+ */
+struct ThreadExecutor {
+    void operator()(std::function<void()> task) const {
+        std::thread(std::move(task)).detach();
+    }
+};
+
+/**
+ * @brief pack an array on several threads
+ *
+ * Every value has a fixed width, so the input is split into chunks whose
+ * output offsets are known up front and each chunk is packed straight
+ * into its part of out.
+ *
+ * @param code a numeric code
+ * @param values
+ * @param n
+ * @param out room for n * php_pack_code_size(code) bytes
+ * @param executor called with one std::function<void()> per chunk, e.g. to
+ * post it to a thread pool. Returns once every chunk has run. If it
+ * throws, it must not have run that chunk, the chunks submitted before are
+ * waited for and the exception is rethrown.
+ * @param chunks number of chunks, at most n. 0 for one per hardware
+ * thread with at least 16384 values each, an explicit count is not
+ * reduced for small arrays
+ * @throw std::invalid_argument if code is not numeric
+ */
+template <typename T, typename Executor = ThreadExecutor,
+          typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+void pack_array_parallel(char code, const T *values, size_t n, char *out,
+                         Executor &&executor = Executor(), size_t chunks = 0) {
+    /* below this many values per chunk threads cost more than they save */
+    constexpr size_t min_chunk = 16384;
+
+    const size_t size = __phpack__detail::php_array_code_size(code);
+    if (chunks == 0) {
+        chunks = std::max(1u, std::thread::hardware_concurrency());
+        chunks = std::min(chunks, (n + min_chunk - 1) / min_chunk);
+    }
+    /* never more chunks than values */
+    chunks = std::min(chunks, n);
+    if (chunks <= 1) {
+        pack_array(code, values, n, out);
+        return;
+    }
+
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t pending = chunks;
+
+    const auto wait = [&] {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return pending == 0; });
+    };
+
+    const size_t per_chunk = (n + chunks - 1) / chunks;
+    for (size_t c = 0; c < chunks; ++c) {
+        const size_t begin = std::min(n, c * per_chunk);
+        const size_t end = std::min(n, begin + per_chunk);
+        try {
+            executor([&, begin, end] {
+                pack_array(code, values + begin, end - begin,
+                           out + begin * size);
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pending == 0) {
+                    done.notify_one();
+                }
+            });
+        } catch (...) {
+            /* the chunks already submitted still use the state on this
+             * stack, let them finish before unwinding it */
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending -= chunks - c;
+            }
+            wait();
+            throw;
+        }
+    }
+
+    wait();
+}
+
+template <typename T, typename Executor = ThreadExecutor,
+          typename std::enable_if<std::is_arithmetic<T>::value &&
+                                      !std::is_pointer<typename std::decay<
+                                          Executor>::type>::value,
+                                  int>::type = 0>
+std::string pack_array_parallel(char code, const T *values, size_t n,
+                                Executor &&executor = Executor(),
+                                size_t chunks = 0) {
+    std::string output(n * __phpack__detail::php_array_code_size(code), '\0');
+    pack_array_parallel(code, values, n, &output[0],
+                        std::forward<Executor>(executor), chunks);
+    return output;
+}
+
+} // namespace PhPacker
+
+#endif /* BULK_H */
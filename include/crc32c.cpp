@@ -0,0 +1,228 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "crc32c.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(PHPACK_X86_KERNELS)
+#include <nmmintrin.h>
+#elif defined(PHPACK_ARMV8_KERNELS)
+#include <arm_acle.h>
+#endif
+
+namespace PhPacker {
+
+namespace __phpack__detail {
+
+namespace {
+
+/* reflected Castagnoli polynomial */
+constexpr uint32_t crc32c_poly = 0x82f63b78;
+
+using crc32c_table = std::array<std::array<uint32_t, 256>, 8>;
+
+constexpr crc32c_table make_crc32c_table() noexcept {
+    crc32c_table t{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k) {
+            c = c & 1 ? (c >> 1) ^ crc32c_poly : c >> 1;
+        }
+        t[0][i] = c;
+    }
+    for (size_t s = 1; s < 8; ++s) {
+        for (size_t i = 0; i < 256; ++i) {
+            t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xff];
+        }
+    }
+    return t;
+}
+
+constexpr crc32c_table crc32c_tables = make_crc32c_table();
+
+} // namespace
+
+uint32_t php_crc32c_software(uint32_t crc, const char *p, size_t n) noexcept {
+    const auto &t = crc32c_tables;
+    for (; n >= 8; n -= 8, p += 8) {
+        const uint64_t word =
+            php_load_uint<8, true>(p) ^ static_cast<uint64_t>(crc);
+        crc = t[7][word & 0xff] ^ t[6][(word >> 8) & 0xff] ^
+              t[5][(word >> 16) & 0xff] ^ t[4][(word >> 24) & 0xff] ^
+              t[3][(word >> 32) & 0xff] ^ t[2][(word >> 40) & 0xff] ^
+              t[1][(word >> 48) & 0xff] ^ t[0][word >> 56];
+    }
+    for (; n > 0; --n, ++p) {
+        crc = (crc >> 8) ^
+              t[0][(crc ^ static_cast<unsigned char>(*p)) & 0xff];
+    }
+    return crc;
+}
+
+#ifdef PHPACK_X86_KERNELS
+PHPACK_TARGET("sse4.2")
+uint32_t php_crc32c_sse42(uint32_t crc, const char *p, size_t n) noexcept {
+#if defined(__x86_64__) || defined(_M_X64)
+    uint64_t c = crc;
+    for (; n >= 8; n -= 8, p += 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        c = _mm_crc32_u64(c, word);
+    }
+    crc = static_cast<uint32_t>(c);
+#endif
+    for (; n >= 4; n -= 4, p += 4) {
+        uint32_t word;
+        memcpy(&word, p, 4);
+        crc = _mm_crc32_u32(crc, word);
+    }
+    for (; n > 0; --n, ++p) {
+        crc = _mm_crc32_u8(crc, static_cast<unsigned char>(*p));
+    }
+    return crc;
+}
+#endif
+
+#ifdef PHPACK_ARMV8_KERNELS
+uint32_t php_crc32c_armv8(uint32_t crc, const char *p, size_t n) noexcept {
+    for (; n >= 8; n -= 8, p += 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        crc = __crc32cd(crc, word);
+    }
+    for (; n > 0; --n, ++p) {
+        crc = __crc32cb(crc, static_cast<uint8_t>(*p));
+    }
+    return crc;
+}
+#endif
+
+void php_check_trailer(char code) {
+    if (code != 'N' && code != 'V') {
+        throw std::invalid_argument(std::string("Type ") + code +
+                                    ": a CRC trailer must be N or V");
+    }
+}
+
+} // namespace __phpack__detail
+
+uint32_t crc32c(const char *data, size_t size, uint32_t crc) noexcept {
+    return ~__phpack__detail::php_kernel_table().crc32c(~crc, data, size);
+}
+
+const char *crc32c_kernel() noexcept {
+    return __phpack__detail::php_kernel_table().crc32c_name;
+}
+
+void append_crc32c(std::string &record, char code) {
+    using namespace __phpack__detail;
+    php_check_trailer(code);
+    const uint32_t crc = crc32c(record);
+    char trailer[4];
+    if (code == 'N') {
+        php_store_uint<4, false>(crc, trailer);
+    } else {
+        php_store_uint<4, true>(crc, trailer);
+    }
+    record.append(trailer, 4);
+}
+
+std::string_view verify_crc32c(std::string_view record, char code) {
+    using namespace __phpack__detail;
+    php_check_trailer(code);
+    if (record.size() < 4) {
+        throw IntegrityError("CRC32C: record of " +
+                             std::to_string(record.size()) +
+                             " bytes has no trailer");
+    }
+    const std::string_view payload = record.substr(0, record.size() - 4);
+    const char *trailer = record.data() + payload.size();
+    const uint64_t expected = code == 'N' ? php_load_uint<4, false>(trailer)
+                                          : php_load_uint<4, true>(trailer);
+    if (crc32c(payload) != expected) {
+        throw IntegrityError("CRC32C: trailer does not match the record");
+    }
+    return payload;
+}
+
+std::vector<std::any> unpack_crc32c(const Format &format,
+                                    std::string_view record, char code) {
+    using namespace __phpack__detail;
+    php_check_trailer(code);
+    if (record.size() < 4) {
+        throw IntegrityError("CRC32C: record of " +
+                             std::to_string(record.size()) +
+                             " bytes has no trailer");
+    }
+    const std::string_view payload = record.substr(0, record.size() - 4);
+    const char *trailer = record.data() + payload.size();
+    const uint64_t expected = code == 'N' ? php_load_uint<4, false>(trailer)
+                                          : php_load_uint<4, true>(trailer);
+    const php_kernels &kernels = php_kernel_table();
+
+    /* the CRC follows the decoder field by field, so every byte is read
+     * once while it is in cache */
+    std::vector<std::any> result;
+    result.reserve(format.args());
+    uint32_t crc = ~0u;
+    size_t done = 0;
+    size_t extra = 0;
+    bool truncated = false;
+    for (const FormatField &field : format.fields()) {
+        const size_t pos = field.offset + extra;
+        size_t size = field.size;
+        if (field.star) {
+            size = pos < payload.size() ? payload.size() - pos : 0;
+            extra += size;
+        }
+        if (pos + size > payload.size()) {
+            truncated = true;
+            break;
+        }
+        crc = kernels.crc32c(crc, payload.data() + done, pos + size - done);
+        done = pos + size;
+        if (field.takes_value()) {
+            result.push_back(
+                php_unpack_field(field, payload.substr(pos, size)));
+        }
+    }
+    crc = kernels.crc32c(crc, payload.data() + done, payload.size() - done);
+    /* a corrupt record is reported as such before it is too short */
+    if (~crc != expected) {
+        throw IntegrityError("CRC32C: trailer does not match the record");
+    }
+    if (truncated) {
+        /* throws the std::out_of_range of Format::unpack */
+        return format.unpack(payload);
+    }
+    return result;
+}
+
+} // namespace PhPacker
@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include "dispatch.h"
+#include "format.h"
+
+#include <any>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace PhPacker {
+
+/**
+ * @brief CRC32C (Castagnoli) of data
+ *
+ * Uses the SSE4.2 or ARMv8 crc32c instructions when kernel_isa() has them
+ * and a slicing by 8 table otherwise. Passing the CRC of a previous buffer
+ * continues it, so crc32c(b, crc32c(a)) is the CRC of a followed by b.
+ */
+uint32_t crc32c(const char *data, size_t size, uint32_t crc = 0) noexcept;
+
+inline uint32_t crc32c(std::string_view data, uint32_t crc = 0) noexcept {
+    return crc32c(data.data(), data.size(), crc);
+}
+
+/**
+ * @brief the kernel crc32c() uses, "sse4.2", "armv8" or "software"
+ */
+const char *crc32c_kernel() noexcept;
+
+/**
+ * @brief Thrown when a record's CRC32C trailer does not match
+ */
+class IntegrityError : public std::runtime_error {
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+namespace __phpack__detail {
+
+/* 'N' or 'V', the codes a trailer can be packed with */
+void php_check_trailer(char code);
+
+/* the table kernel, crc is neither inverted on input nor output */
+uint32_t php_crc32c_software(uint32_t crc, const char *data,
+                             size_t size) noexcept;
+
+#ifdef PHPACK_X86_KERNELS
+uint32_t php_crc32c_sse42(uint32_t crc, const char *data,
+                          size_t size) noexcept;
+#endif
+
+#ifdef PHPACK_ARMV8_KERNELS
+uint32_t php_crc32c_armv8(uint32_t crc, const char *data,
+                          size_t size) noexcept;
+#endif
+
+} // namespace __phpack__detail
+
+/**
+ * @brief append the CRC32C of record to it
+ * @param record
+ * @param code 'N' for a big endian trailer, 'V' for little endian
+ * @throw std::invalid_argument for other codes
+ */
+void append_crc32c(std::string &record, char code = 'N');
+
+/**
+ * @brief check the trailer of a record written by append_crc32c
+ * @return the record without its trailer
+ * @throw IntegrityError if the record is too short or the CRC differs
+ */
+std::string_view verify_crc32c(std::string_view record, char code = 'N');
+
+/**
+ * @brief pack a record followed by its CRC32C trailer, the CRC is taken
+ * right after packing while the bytes are in cache
+ * @throw std::invalid_argument if the arguments do not match format
+ */
+template <typename... Args>
+std::string pack_crc32c(const Format &format, char code,
+                        const Args &...args) {
+    __phpack__detail::php_check_trailer(code);
+    const size_t size =
+        format.fixed() ? format.size() : format.packed_size(args...);
+    std::string output(size + 4, '\0');
+    output.resize(format.pack_to(&output[0], output.size(), args...));
+    append_crc32c(output, code);
+    return output;
+}
+
+/**
+ * @brief unpack a record packed by pack_crc32c, taking its CRC32C field by
+ * field in the same pass
+ * @throw IntegrityError if the CRC differs, even if the record is short
+ * @throw std::out_of_range as Format::unpack
+ */
+std::vector<std::any> unpack_crc32c(const Format &format,
+                                    std::string_view record, char code = 'N');
+
+} // namespace PhPacker
+
+#endif /* CRC32C_H */
@@ -0,0 +1,219 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "delta.h"
+#include "bulk.h"
+
+#include <stdexcept>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PHPACK_DELTA_SSE2 1
+#endif
+
+namespace PhPacker {
+
+namespace __phpack__detail {
+
+uint64_t php_prefix_sum(uint64_t *v, size_t n, uint64_t base) noexcept {
+    size_t i = 0;
+#ifdef PHPACK_DELTA_SSE2
+    __m128i carry = _mm_set1_epi64x(static_cast<long long>(base));
+    for (; i + 2 <= n; i += 2) {
+        __m128i *p = reinterpret_cast<__m128i *>(v + i);
+        __m128i x = _mm_loadu_si128(p);
+        x = _mm_add_epi64(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi64(x, carry);
+        _mm_storeu_si128(p, x);
+        /* broadcast the high lane, the running sum */
+        carry = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 2, 3, 2));
+    }
+    if (i > 0) {
+        base = v[i - 1];
+    }
+#endif
+    for (; i < n; ++i) {
+        base += v[i];
+        v[i] = base;
+    }
+    return base;
+}
+
+namespace {
+
+inline uint64_t zigzag(uint64_t v) noexcept {
+    return (v << 1) ^ (0 - (v >> 63));
+}
+
+inline uint64_t unzigzag(uint64_t v) noexcept {
+    return (v >> 1) ^ (0 - (v & 1));
+}
+
+void put_varint(uint64_t v, std::string &output) {
+    while (v >= 0x80) {
+        output.push_back(
+            static_cast<char>(static_cast<unsigned char>(v | 0x80)));
+        v >>= 7;
+    }
+    output.push_back(static_cast<char>(static_cast<unsigned char>(v)));
+}
+
+const char *get_varint(const char *p, const char *end, uint64_t &v) {
+    v = 0;
+    for (unsigned shift = 0; p != end && shift < 64; shift += 7) {
+        const auto byte = static_cast<unsigned char>(*p++);
+        v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return p;
+        }
+    }
+    throw std::out_of_range("unpack_delta: truncated varint");
+}
+
+void check_code(char code) {
+    if (code != 0 && (php_pack_code_size(code) == 0 ||
+                      php_pack_code_is_float(code))) {
+        throw std::invalid_argument(std::string("Type ") + code +
+                                    ": not an integer code");
+    }
+}
+
+void check_range(char code, const int64_t *deltas, size_t n) {
+    const size_t bits = php_pack_code_size(code) * 8;
+    if (bits >= 64) {
+        return;
+    }
+    const bool is_signed = php_code_is_signed(code);
+    const int64_t min = is_signed ? -(int64_t{1} << (bits - 1)) : 0;
+    const int64_t max = is_signed ? (int64_t{1} << (bits - 1)) - 1
+                                  : (int64_t{1} << bits) - 1;
+    for (size_t i = 0; i < n; ++i) {
+        if (deltas[i] < min || deltas[i] > max) {
+            throw std::out_of_range(std::string("Type ") + code + ": delta " +
+                                    std::to_string(deltas[i]) +
+                                    " at index " + std::to_string(i) +
+                                    " does not fit");
+        }
+    }
+}
+
+} // namespace
+
+} // namespace __phpack__detail
+
+std::string pack_delta(const int64_t *values, size_t n, DeltaMode mode,
+                       char code) {
+    using namespace __phpack__detail;
+
+    check_code(code);
+
+    /* differences are taken modulo 2^64 */
+    const size_t seeds = mode == DeltaMode::Delta ? 1 : 2;
+    std::vector<uint64_t> seed;
+    std::vector<int64_t> deltas;
+    deltas.reserve(n);
+    uint64_t prev = 0;
+    uint64_t prev_delta = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t v = static_cast<uint64_t>(values[i]);
+        const uint64_t delta = v - prev;
+        const uint64_t d =
+            mode == DeltaMode::Delta ? delta : delta - prev_delta;
+        if (i < seeds) {
+            seed.push_back(i == 0 ? v : delta);
+        } else {
+            deltas.push_back(static_cast<int64_t>(d));
+        }
+        prev = v;
+        prev_delta = delta;
+    }
+
+    std::string output(seed.size() * 8, '\0');
+    pack_array('P', seed.data(), seed.size(), &output[0]);
+
+    if (code == 0) {
+        for (int64_t d : deltas) {
+            put_varint(zigzag(static_cast<uint64_t>(d)), output);
+        }
+    } else {
+        check_range(code, deltas.data(), deltas.size());
+        output += pack_array(code, deltas.data(), deltas.size());
+    }
+    return output;
+}
+
+size_t unpack_delta(std::string_view data, size_t n, int64_t *out,
+                    DeltaMode mode, char code) {
+    using namespace __phpack__detail;
+
+    check_code(code);
+    if (n == 0) {
+        return 0;
+    }
+
+    const size_t seeds = mode == DeltaMode::Delta || n == 1 ? 1 : 2;
+    if (data.size() < seeds * 8) {
+        throw std::out_of_range("unpack_delta: not enough input");
+    }
+    uint64_t seed[2] = {};
+    unpack_array('P', data.data(), seeds, seed);
+
+    /* the deltas go to out first and are summed in place */
+    uint64_t *v = reinterpret_cast<uint64_t *>(out);
+    const size_t count = n - seeds;
+    size_t used = seeds * 8;
+    if (code == 0) {
+        const char *p = data.data() + used;
+        const char *end = data.data() + data.size();
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t z = 0;
+            p = get_varint(p, end, z);
+            v[seeds + i] = unzigzag(z);
+        }
+        used = static_cast<size_t>(p - data.data());
+    } else {
+        const size_t size = php_pack_code_size(code);
+        if ((data.size() - used) / size < count) {
+            throw std::out_of_range("unpack_delta: not enough input");
+        }
+        unpack_array(code, data.data() + used, count, out + seeds);
+        used += count * size;
+    }
+
+    v[0] = seed[0];
+    if (mode == DeltaMode::DeltaOfDelta && seeds == 2) {
+        /* delta of delta -> delta, then delta -> value */
+        v[1] = seed[1];
+        php_prefix_sum(v + 2, count, seed[1]);
+    }
+    php_prefix_sum(v + 1, n - 1, seed[0]);
+    return used;
+}
+
+} // namespace PhPacker
@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef DELTA_H
+#define DELTA_H
+
+#include "pack.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace PhPacker {
+
+/**
+ * @brief What a delta column stores between values
+ *
+ * Delta stores v[i] - v[i-1], which is small for sorted columns.
+ * DeltaOfDelta stores the change of the delta, which is close to 0 for
+ * regular timestamps or sequence numbers.
+ */
+enum class DeltaMode { Delta, DeltaOfDelta };
+
+namespace __phpack__detail {
+
+/* v[i] += base + v[0] + ... + v[i-1], returns the last sum */
+uint64_t php_prefix_sum(uint64_t *v, size_t n, uint64_t base) noexcept;
+
+} // namespace __phpack__detail
+
+/**
+ * @brief delta encode a column of integers
+ *
+ * The first value, and the first delta for DeltaOfDelta, are stored in 8
+ * little endian bytes, the remaining deltas either as zigzag varints or
+ * packed with a fixed width integer code such as 'c' or 'n'.
+ *
+ * @param values
+ * @param n
+ * @param mode
+ * @param code 0 for varints, else an integer code for every delta
+ * @return string
+ * @throw std::invalid_argument if code is not an integer code
+ * @throw std::out_of_range if a delta does not fit code
+ */
+std::string pack_delta(const int64_t *values, size_t n,
+                       DeltaMode mode = DeltaMode::Delta, char code = 0);
+
+/**
+ * @brief decode n values packed by pack_delta with the same mode and code
+ * @param data
+ * @param n
+ * @param out room for n values
+ * @param mode
+ * @param code
+ * @return number of bytes of data used
+ * @throw std::out_of_range if data is too short
+ */
+size_t unpack_delta(std::string_view data, size_t n, int64_t *out,
+                    DeltaMode mode = DeltaMode::Delta, char code = 0);
+
+} // namespace PhPacker
+
+#endif /* DELTA_H */
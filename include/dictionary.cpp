@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "dictionary.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+namespace PhPacker {
+
+size_t StringDictionary::add(std::string_view s) {
+    /* keep the table at most 3/4 full */
+    if (4 * (m_entries.size() + 1) > 3 * m_slots.size()) {
+        grow();
+    }
+    const size_t hash = std::hash<std::string_view>()(s);
+    const size_t mask = m_slots.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const uint32_t slot = m_slots[i];
+        if (slot == 0) {
+            /* counts and lengths are packed as N */
+            constexpr size_t max = std::numeric_limits<uint32_t>::max();
+            if (m_entries.size() >= max || s.size() > max) {
+                throw std::length_error("StringDictionary: table too large");
+            }
+            m_entries.push_back({m_bytes.size(), s.size(), hash});
+            m_slots[i] = static_cast<uint32_t>(m_entries.size());
+            m_bytes.append(s);
+            m_packed_size += 4 + s.size();
+            return m_entries.size() - 1;
+        }
+        const Entry &e = m_entries[slot - 1];
+        if (e.hash == hash && e.size == s.size() &&
+            memcmp(m_bytes.data() + e.offset, s.data(), s.size()) == 0) {
+            return slot - 1;
+        }
+    }
+}
+
+void StringDictionary::grow() {
+    m_slots.assign(std::max<size_t>(64, 2 * m_slots.size()), 0);
+    const size_t mask = m_slots.size() - 1;
+    for (size_t k = 0; k < m_entries.size(); ++k) {
+        size_t i = m_entries[k].hash & mask;
+        while (m_slots[i] != 0) {
+            i = (i + 1) & mask;
+        }
+        m_slots[i] = static_cast<uint32_t>(k + 1);
+    }
+}
+
+void StringDictionary::clear() noexcept {
+    if (!m_entries.empty()) {
+        std::fill(m_slots.begin(), m_slots.end(), 0);
+    }
+    m_entries.clear();
+    m_bytes.clear();
+    m_packed_size = 4;
+}
+
+void StringDictionary::pack_to(char *out) const noexcept {
+    using namespace __phpack__detail;
+    php_store_uint<4, false>(m_entries.size(), out);
+    out += 4;
+    for (const Entry &e : m_entries) {
+        php_store_uint<4, false>(e.size, out);
+        memcpy(out + 4, m_bytes.data() + e.offset, e.size);
+        out += 4 + e.size;
+    }
+}
+
+std::string StringDictionary::pack() const {
+    std::string output(m_packed_size, '\0');
+    pack_to(&output[0]);
+    return output;
+}
+
+std::string_view unpack_dictionary(std::string_view data,
+                                   std::vector<std::string_view> &table) {
+    using namespace __phpack__detail;
+    table.clear();
+    if (data.size() < 4) {
+        throw std::out_of_range("unpack_dictionary: no table");
+    }
+    const uint64_t count = php_load_uint<4, false>(data.data());
+    size_t pos = 4;
+    for (uint64_t i = 0; i < count; ++i) {
+        if (data.size() - pos < 4) {
+            throw std::out_of_range("unpack_dictionary: table truncated");
+        }
+        const auto size =
+            php_narrow<size_t>(php_load_uint<4, false>(data.data() + pos));
+        pos += 4;
+        if (data.size() - pos < size) {
+            throw std::out_of_range("unpack_dictionary: table truncated");
+        }
+        table.push_back(data.substr(pos, size));
+        pos += size;
+    }
+    return data.substr(pos);
+}
+
+} // namespace PhPacker
@@ -0,0 +1,174 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include "batch.h"
+#include "format.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace PhPacker {
+
+/**
+ * @brief Deduplicates the strings of a batch into a table of indexes
+ *
+ * add() returns the index of a string, adding it the first time it is
+ * seen. clear() forgets the strings but keeps the hash table and the
+ * storage, so a dictionary reused across batches of similar strings does
+ * not allocate or rehash after the first few.
+ *
+ * The packed table is the number of strings as an N followed by each
+ * string as an N length and its bytes.
+ */
+class StringDictionary {
+  public:
+    /**
+     * @brief index of s, added if it is new
+     */
+    size_t add(std::string_view s);
+
+    size_t size() const noexcept { return m_entries.size(); }
+    bool empty() const noexcept { return m_entries.empty(); }
+
+    std::string_view operator[](size_t index) const noexcept {
+        const Entry &e = m_entries[index];
+        return std::string_view(m_bytes.data() + e.offset, e.size);
+    }
+
+    void clear() noexcept;
+
+    /**
+     * @brief bytes written by pack_to()
+     */
+    size_t packed_size() const noexcept { return m_packed_size; }
+
+    void pack_to(char *out) const noexcept;
+
+    std::string pack() const;
+
+  private:
+    struct Entry {
+        size_t offset;
+        size_t size;
+        size_t hash;
+    };
+
+    void grow();
+
+    std::string m_bytes;
+    std::vector<Entry> m_entries;
+    /* open addressing, entry index + 1 or 0 for an empty slot */
+    std::vector<uint32_t> m_slots;
+    size_t m_packed_size = 4;
+};
+
+/**
+ * @brief read a table packed by StringDictionary
+ * @param table replaced by views into data
+ * @return the rest of data
+ * @throw std::out_of_range if data ends inside the table
+ */
+std::string_view unpack_dictionary(std::string_view data,
+                                   std::vector<std::string_view> &table);
+
+/**
+ * @brief pack records whose std::string or std::string_view members are
+ * stored as their index in dictionary, packed with the member's field
+ * code, usually C or n
+ *
+ * The dictionary is not cleared, so several calls can share one table.
+ *
+ * @throw RangeError with the record index if an index doesn't fit its
+ * code
+ * @throw std::invalid_argument as pack_batch, or if a string member has
+ * a float code
+ */
+template <typename R>
+void pack_batch(const Format &format, const R *records, size_t n, char *out,
+                StringDictionary &dictionary) {
+    __phpack__detail::php_pack_batch(format, records, n, out, &dictionary);
+}
+
+/**
+ * @brief the dictionary of a batch followed by its records
+ *
+ * dictionary is cleared first and holds the batch's strings afterwards.
+ */
+template <typename R>
+std::string pack_batch(const Format &format, const R *records, size_t n,
+                       StringDictionary &dictionary) {
+    dictionary.clear();
+    std::string packed(n * format.size(), '\0');
+    pack_batch(format, records, n, &packed[0], dictionary);
+    std::string output(dictionary.packed_size() + packed.size(), '\0');
+    dictionary.pack_to(&output[0]);
+    memcpy(&output[dictionary.packed_size()], packed.data(), packed.size());
+    return output;
+}
+
+template <typename R>
+std::string pack_batch(const Format &format, const std::vector<R> &records,
+                       StringDictionary &dictionary) {
+    return pack_batch(format, records.data(), records.size(), dictionary);
+}
+
+/**
+ * @brief unpack records whose string members are indexes into table
+ * @throw std::out_of_range if an index is beyond table or data is short
+ */
+template <typename R>
+void unpack_batch(const Format &format, std::string_view data, R *records,
+                  size_t n, const std::vector<std::string_view> &table) {
+    __phpack__detail::php_unpack_batch(format, data, records, n, &table);
+}
+
+/**
+ * @brief unpack a batch packed with its dictionary
+ *
+ * std::string_view members point into data.
+ *
+ * @param table reused for the dictionary of the batch
+ */
+template <typename R>
+std::vector<R> unpack_batch(const Format &format, std::string_view data,
+                            std::vector<std::string_view> &table) {
+    const std::string_view rest = unpack_dictionary(data, table);
+    std::vector<R> records(format.size() ? rest.size() / format.size() : 0);
+    unpack_batch(format, rest, records.data(), records.size(), table);
+    return records;
+}
+
+} // namespace PhPacker
+
+#endif /* DICTIONARY_H */
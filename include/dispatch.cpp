@@ -0,0 +1,478 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "dispatch.h"
+#include "crc32c.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(PHPACK_X86_KERNELS)
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+namespace PhPacker {
+
+namespace __phpack__detail {
+
+namespace {
+
+template <size_t Size>
+void bswap_scalar(const char *src, size_t n, char *dst) noexcept {
+    for (size_t i = 0; i < n; ++i, src += Size, dst += Size) {
+        php_store_uint<Size, false>(php_load_uint<Size, true>(src), dst);
+    }
+}
+
+const char hexchars[] = "0123456789abcdef";
+
+void hex_encode_scalar(const char *src, size_t nibbles, char *dst,
+                       bool high_first) noexcept {
+    for (size_t i = 0; i < nibbles; ++i) {
+        const auto byte = static_cast<unsigned char>(src[i / 2]);
+        const bool high = (i % 2 == 0) == high_first;
+        dst[i] = hexchars[high ? byte >> 4 : byte & 0xf];
+    }
+}
+
+/* the value of a valid hex digit, letters have bit 6 set */
+inline unsigned hex_digit(char c) noexcept {
+    const auto u = static_cast<unsigned char>(c);
+    return (u & 0xfu) + 9 * (u >> 6);
+}
+
+void hex_decode_scalar(const char *src, size_t nibbles, char *dst,
+                       bool high_first) noexcept {
+    for (; nibbles >= 2; nibbles -= 2, src += 2) {
+        const unsigned first = hex_digit(src[0]);
+        const unsigned second = hex_digit(src[1]);
+        *dst++ = static_cast<char>(high_first ? first << 4 | second
+                                              : second << 4 | first);
+    }
+    if (nibbles) {
+        const unsigned last = hex_digit(src[0]);
+        *dst = static_cast<char>(high_first ? last << 4 : last);
+    }
+}
+
+void f64_to_f32_scalar(const double *src, size_t n, float *dst) noexcept {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = static_cast<float>(src[i]);
+    }
+}
+
+void f32_to_f64_scalar(const float *src, size_t n, double *dst) noexcept {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = static_cast<double>(src[i]);
+    }
+}
+
+#ifdef PHPACK_X86_KERNELS
+
+/* pshufb indices reversing each Size byte value of a 16 byte lane */
+template <size_t Size> struct bswap_mask {
+    alignas(64) char bytes[64];
+
+    constexpr bswap_mask() : bytes() {
+        for (size_t i = 0; i < 64; ++i) {
+            const size_t lane = i % 16;
+            bytes[i] = static_cast<char>(lane - lane % Size + Size - 1 -
+                                         lane % Size);
+        }
+    }
+};
+
+template <size_t Size> constexpr bswap_mask<Size> bswap_masks{};
+
+template <size_t Size>
+PHPACK_TARGET("sse4.2")
+void bswap_sse42(const char *src, size_t n, char *dst) noexcept {
+    const __m128i mask = _mm_load_si128(
+        reinterpret_cast<const __m128i *>(bswap_masks<Size>.bytes));
+    constexpr size_t per = 16 / Size;
+    for (; n >= per; n -= per, src += 16, dst += 16) {
+        const __m128i v =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst),
+                         _mm_shuffle_epi8(v, mask));
+    }
+    bswap_scalar<Size>(src, n, dst);
+}
+
+template <size_t Size>
+PHPACK_TARGET("avx2")
+void bswap_avx2(const char *src, size_t n, char *dst) noexcept {
+    const __m256i mask = _mm256_load_si256(
+        reinterpret_cast<const __m256i *>(bswap_masks<Size>.bytes));
+    constexpr size_t per = 32 / Size;
+    for (; n >= per; n -= per, src += 32, dst += 32) {
+        const __m256i v =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst),
+                            _mm256_shuffle_epi8(v, mask));
+    }
+    bswap_sse42<Size>(src, n, dst);
+}
+
+template <size_t Size>
+PHPACK_TARGET("avx512f,avx512bw")
+void bswap_avx512(const char *src, size_t n, char *dst) noexcept {
+    const __m512i mask = _mm512_load_si512(bswap_masks<Size>.bytes);
+    constexpr size_t per = 64 / Size;
+    for (; n >= per; n -= per, src += 64, dst += 64) {
+        _mm512_storeu_si512(dst,
+                            _mm512_shuffle_epi8(_mm512_loadu_si512(src), mask));
+    }
+    bswap_avx2<Size>(src, n, dst);
+}
+
+/* 16 bytes to 32 digits, in the order of the bytes */
+PHPACK_TARGET("sse4.2")
+void hex_encode_sse42(const char *src, size_t nibbles, char *dst,
+                      bool high_first) noexcept {
+    const __m128i digits =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(hexchars));
+    const __m128i low4 = _mm_set1_epi8(0x0f);
+    for (; nibbles >= 32; nibbles -= 32, src += 16, dst += 32) {
+        const __m128i v =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+        const __m128i hi =
+            _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(v, 4), low4));
+        const __m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(v, low4));
+        const __m128i first = high_first ? hi : lo;
+        const __m128i second = high_first ? lo : hi;
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst),
+                         _mm_unpacklo_epi8(first, second));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 16),
+                         _mm_unpackhi_epi8(first, second));
+    }
+    hex_encode_scalar(src, nibbles, dst, high_first);
+}
+
+PHPACK_TARGET("avx2")
+void hex_encode_avx2(const char *src, size_t nibbles, char *dst,
+                     bool high_first) noexcept {
+    const __m256i digits = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(hexchars)));
+    const __m256i low4 = _mm256_set1_epi8(0x0f);
+    for (; nibbles >= 64; nibbles -= 64, src += 32, dst += 64) {
+        const __m256i v =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+        const __m256i hi = _mm256_shuffle_epi8(
+            digits, _mm256_and_si256(_mm256_srli_epi16(v, 4), low4));
+        const __m256i lo =
+            _mm256_shuffle_epi8(digits, _mm256_and_si256(v, low4));
+        const __m256i first = high_first ? hi : lo;
+        const __m256i second = high_first ? lo : hi;
+        /* unpack works within 128 bit lanes */
+        const __m256i a = _mm256_unpacklo_epi8(first, second);
+        const __m256i b = _mm256_unpackhi_epi8(first, second);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst),
+                            _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 32),
+                            _mm256_permute2x128_si256(a, b, 0x31));
+    }
+    hex_encode_sse42(src, nibbles, dst, high_first);
+}
+
+/* 16 digits to their values, see hex_digit() */
+PHPACK_TARGET("sse4.2")
+inline __m128i hex_digits_sse42(__m128i c) noexcept {
+    const __m128i letters = _mm_and_si128(
+        _mm_cmpgt_epi8(c, _mm_set1_epi8(0x40)), _mm_set1_epi8(9));
+    return _mm_add_epi8(_mm_and_si128(c, _mm_set1_epi8(0x0f)), letters);
+}
+
+PHPACK_TARGET("sse4.2")
+void hex_decode_sse42(const char *src, size_t nibbles, char *dst,
+                      bool high_first) noexcept {
+    /* pairs of digits to bytes, first * 16 + second or the reverse */
+    const __m128i weights = _mm_set1_epi16(high_first ? 0x0110 : 0x1001);
+    for (; nibbles >= 32; nibbles -= 32, src += 32, dst += 16) {
+        const __m128i a = hex_digits_sse42(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(src)));
+        const __m128i b = hex_digits_sse42(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst),
+                         _mm_packus_epi16(_mm_maddubs_epi16(a, weights),
+                                          _mm_maddubs_epi16(b, weights)));
+    }
+    hex_decode_scalar(src, nibbles, dst, high_first);
+}
+
+PHPACK_TARGET("avx2")
+inline __m256i hex_digits_avx2(__m256i c) noexcept {
+    const __m256i letters = _mm256_and_si256(
+        _mm256_cmpgt_epi8(c, _mm256_set1_epi8(0x40)), _mm256_set1_epi8(9));
+    return _mm256_add_epi8(_mm256_and_si256(c, _mm256_set1_epi8(0x0f)),
+                           letters);
+}
+
+PHPACK_TARGET("avx2")
+void hex_decode_avx2(const char *src, size_t nibbles, char *dst,
+                     bool high_first) noexcept {
+    const __m256i weights = _mm256_set1_epi16(high_first ? 0x0110 : 0x1001);
+    for (; nibbles >= 64; nibbles -= 64, src += 64, dst += 32) {
+        const __m256i a = hex_digits_avx2(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src)));
+        const __m256i b = hex_digits_avx2(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 32)));
+        /* pack works within 128 bit lanes, put the quarters back in order */
+        const __m256i packed = _mm256_packus_epi16(
+            _mm256_maddubs_epi16(a, weights), _mm256_maddubs_epi16(b, weights));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst),
+                            _mm256_permute4x64_epi64(packed, 0xd8));
+    }
+    hex_decode_sse42(src, nibbles, dst, high_first);
+}
+
+PHPACK_TARGET("sse4.2")
+void f64_to_f32_sse42(const double *src, size_t n, float *dst) noexcept {
+    for (; n >= 4; n -= 4, src += 4, dst += 4) {
+        const __m128 a = _mm_cvtpd_ps(_mm_loadu_pd(src));
+        const __m128 b = _mm_cvtpd_ps(_mm_loadu_pd(src + 2));
+        _mm_storeu_ps(dst, _mm_movelh_ps(a, b));
+    }
+    f64_to_f32_scalar(src, n, dst);
+}
+
+PHPACK_TARGET("sse4.2")
+void f32_to_f64_sse42(const float *src, size_t n, double *dst) noexcept {
+    for (; n >= 4; n -= 4, src += 4, dst += 4) {
+        const __m128 v = _mm_loadu_ps(src);
+        _mm_storeu_pd(dst, _mm_cvtps_pd(v));
+        _mm_storeu_pd(dst + 2, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+    }
+    f32_to_f64_scalar(src, n, dst);
+}
+
+PHPACK_TARGET("avx2")
+void f64_to_f32_avx2(const double *src, size_t n, float *dst) noexcept {
+    for (; n >= 4; n -= 4, src += 4, dst += 4) {
+        _mm_storeu_ps(dst, _mm256_cvtpd_ps(_mm256_loadu_pd(src)));
+    }
+    f64_to_f32_scalar(src, n, dst);
+}
+
+PHPACK_TARGET("avx2")
+void f32_to_f64_avx2(const float *src, size_t n, double *dst) noexcept {
+    for (; n >= 4; n -= 4, src += 4, dst += 4) {
+        _mm256_storeu_pd(dst, _mm256_cvtps_pd(_mm_loadu_ps(src)));
+    }
+    f32_to_f64_scalar(src, n, dst);
+}
+
+PHPACK_TARGET("avx512f,avx512bw")
+void f64_to_f32_avx512(const double *src, size_t n, float *dst) noexcept {
+    /* maskz forms, the plain ones trip -Wmaybe-uninitialized in gcc 12 */
+    for (; n >= 8; n -= 8, src += 8, dst += 8) {
+        _mm256_storeu_ps(dst,
+                         _mm512_maskz_cvtpd_ps(0xff, _mm512_loadu_pd(src)));
+    }
+    f64_to_f32_avx2(src, n, dst);
+}
+
+PHPACK_TARGET("avx512f,avx512bw")
+void f32_to_f64_avx512(const float *src, size_t n, double *dst) noexcept {
+    for (; n >= 8; n -= 8, src += 8, dst += 8) {
+        _mm512_storeu_pd(dst,
+                         _mm512_maskz_cvtps_pd(0xff, _mm256_loadu_ps(src)));
+    }
+    f32_to_f64_avx2(src, n, dst);
+}
+
+#endif
+
+const php_kernels scalar_kernels = {
+    Isa::Scalar,       bswap_scalar<2>,   bswap_scalar<4>,
+    bswap_scalar<8>,   hex_encode_scalar, hex_decode_scalar,
+    f64_to_f32_scalar, f32_to_f64_scalar, php_crc32c_software,
+    "software"};
+
+#ifdef PHPACK_X86_KERNELS
+const php_kernels sse42_kernels = {
+    Isa::SSE42,       bswap_sse42<2>,   bswap_sse42<4>,
+    bswap_sse42<8>,   hex_encode_sse42, hex_decode_sse42,
+    f64_to_f32_sse42, f32_to_f64_sse42, php_crc32c_sse42,
+    "sse4.2"};
+
+const php_kernels avx2_kernels = {
+    Isa::AVX2,       bswap_avx2<2>,   bswap_avx2<4>,
+    bswap_avx2<8>,   hex_encode_avx2, hex_decode_avx2,
+    f64_to_f32_avx2, f32_to_f64_avx2, php_crc32c_sse42,
+    "sse4.2"};
+
+/* 512 bit hex kernels would need AVX512VBMI for the byte permutes */
+const php_kernels avx512_kernels = {
+    Isa::AVX512,       bswap_avx512<2>,   bswap_avx512<4>,
+    bswap_avx512<8>,   hex_encode_avx2,   hex_decode_avx2,
+    f64_to_f32_avx512, f32_to_f64_avx512, php_crc32c_sse42,
+    "sse4.2"};
+#endif
+
+#ifdef PHPACK_ARMV8_KERNELS
+const php_kernels armv8_kernels = {
+    Isa::ArmV8,        bswap_scalar<2>,   bswap_scalar<4>,
+    bswap_scalar<8>,   hex_encode_scalar, hex_decode_scalar,
+    f64_to_f32_scalar, f32_to_f64_scalar, php_crc32c_armv8,
+    "armv8"};
+#endif
+
+Isa detect_isa() noexcept {
+#if defined(PHPACK_X86_KERNELS) && (defined(__GNUC__) || defined(__clang__))
+    /* these also check that the OS saves the wider registers */
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512bw")) {
+        return Isa::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return Isa::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("ssse3")) {
+        return Isa::SSE42;
+    }
+#elif defined(PHPACK_X86_KERNELS)
+    int info[4];
+    __cpuid(info, 0);
+    const int max = info[0];
+    __cpuid(info, 1);
+    const bool ssse3 = info[2] & (1 << 9);
+    const bool sse42 = info[2] & (1 << 20);
+    const bool osxsave = info[2] & (1 << 27);
+    const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    bool avx2 = false;
+    bool avx512 = false;
+    if (max >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) && (xcr0 & 0x6) == 0x6;
+        avx512 = (info[1] & (1 << 16)) && (info[1] & (1 << 30)) &&
+                 (xcr0 & 0xe6) == 0xe6;
+    }
+    if (avx512) {
+        return Isa::AVX512;
+    }
+    if (avx2) {
+        return Isa::AVX2;
+    }
+    if (sse42 && ssse3) {
+        return Isa::SSE42;
+    }
+#elif defined(PHPACK_ARMV8_KERNELS)
+    return Isa::ArmV8;
+#endif
+    return Isa::Scalar;
+}
+
+} // namespace
+
+const php_kernels &php_kernel_table(Isa isa) noexcept {
+    switch (isa) {
+#ifdef PHPACK_X86_KERNELS
+    case Isa::SSE42:
+        return sse42_kernels;
+    case Isa::AVX2:
+        return avx2_kernels;
+    case Isa::AVX512:
+        return avx512_kernels;
+#endif
+#ifdef PHPACK_ARMV8_KERNELS
+    case Isa::ArmV8:
+        return armv8_kernels;
+#endif
+    default:
+        return scalar_kernels;
+    }
+}
+
+const php_kernels &php_kernel_table() noexcept {
+    static const php_kernels &kernels = php_kernel_table(kernel_isa());
+    return kernels;
+}
+
+Isa php_select_isa(const char *name) noexcept {
+    if (name) {
+        for (Isa isa : {Isa::Scalar, Isa::SSE42, Isa::AVX2, Isa::AVX512,
+                        Isa::ArmV8}) {
+            if (std::strcmp(name, isa_name(isa)) == 0 && isa_supported(isa)) {
+                return isa;
+            }
+        }
+    }
+    return cpu_isa();
+}
+
+} // namespace __phpack__detail
+
+const char *isa_name(Isa isa) noexcept {
+    switch (isa) {
+    case Isa::Scalar:
+        return "scalar";
+    case Isa::SSE42:
+        return "sse4.2";
+    case Isa::AVX2:
+        return "avx2";
+    case Isa::AVX512:
+        return "avx512";
+    case Isa::ArmV8:
+        return "armv8";
+    }
+    return "unknown";
+}
+
+bool isa_supported(Isa isa) noexcept {
+    const Isa cpu = cpu_isa();
+    switch (isa) {
+    case Isa::Scalar:
+        return true;
+    case Isa::SSE42:
+    case Isa::AVX2:
+    case Isa::AVX512:
+        /* each x86 level implies the ones before it */
+        return cpu != Isa::ArmV8 && isa <= cpu;
+    case Isa::ArmV8:
+        return cpu == Isa::ArmV8;
+    }
+    return false;
+}
+
+Isa cpu_isa() noexcept {
+    static const Isa isa = __phpack__detail::detect_isa();
+    return isa;
+}
+
+Isa kernel_isa() noexcept {
+    static const Isa isa =
+        __phpack__detail::php_select_isa(std::getenv("PHPACK_ISA"));
+    return isa;
+}
+
+} // namespace PhPacker
@@ -0,0 +1,158 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include "pack.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/* x86 kernels are compiled for each ISA with target attributes, so the
+ * library itself needs no -m flags */
+#if (defined(__x86_64__) || defined(__i386__)) &&                              \
+    (defined(__GNUC__) || defined(__clang__))
+#define PHPACK_X86_KERNELS 1
+#define PHPACK_TARGET(isa) __attribute__((target(isa)))
+#elif defined(_M_X64)
+#define PHPACK_X86_KERNELS 1
+#define PHPACK_TARGET(isa)
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define PHPACK_ARMV8_KERNELS 1
+#endif
+
+namespace PhPacker {
+
+/**
+ * @brief The instruction sets the bulk kernels are built for
+ *
+ * SSE42 also uses SSSE3 shuffles, AVX512 needs AVX512F and AVX512BW.
+ * ArmV8 only adds the CRC32C instructions.
+ */
+enum class Isa { Scalar, SSE42, AVX2, AVX512, ArmV8 };
+
+const char *isa_name(Isa isa) noexcept;
+
+/**
+ * @brief true if this build has kernels for isa and the CPU runs them
+ */
+bool isa_supported(Isa isa) noexcept;
+
+/**
+ * @brief the best ISA this build and CPU support
+ */
+Isa cpu_isa() noexcept;
+
+/**
+ * @brief the ISA of the kernels in use
+ *
+ * Chosen on first use: cpu_isa(), unless the PHPACK_ISA environment
+ * variable names a supported one, e.g. PHPACK_ISA=scalar forces the
+ * portable kernels for testing.
+ */
+Isa kernel_isa() noexcept;
+
+namespace __phpack__detail {
+
+/* the kernels of one ISA. bswap reverses the bytes of n values, hex
+ * kernels convert n nibbles, high nibble first for H, and hex_decode
+ * expects valid digits */
+struct php_kernels {
+    Isa isa;
+    void (*bswap16)(const char *src, size_t n, char *dst) noexcept;
+    void (*bswap32)(const char *src, size_t n, char *dst) noexcept;
+    void (*bswap64)(const char *src, size_t n, char *dst) noexcept;
+    void (*hex_encode)(const char *src, size_t nibbles, char *dst,
+                       bool high_first) noexcept;
+    void (*hex_decode)(const char *src, size_t nibbles, char *dst,
+                       bool high_first) noexcept;
+    void (*f64_to_f32)(const double *src, size_t n, float *dst) noexcept;
+    void (*f32_to_f64)(const float *src, size_t n, double *dst) noexcept;
+    /* crc is neither inverted on input nor output */
+    uint32_t (*crc32c)(uint32_t crc, const char *src, size_t n) noexcept;
+    const char *crc32c_name;
+};
+
+/* the kernels of isa, which must be supported */
+const php_kernels &php_kernel_table(Isa isa) noexcept;
+
+/* the kernels of kernel_isa() */
+const php_kernels &php_kernel_table() noexcept;
+
+/* what kernel_isa() picks for a PHPACK_ISA value, name may be nullptr.
+ * cpu_isa() for a null, unknown or unsupported name */
+Isa php_select_isa(const char *name) noexcept;
+
+/* byte reverses n values of Size bytes, src may equal dst */
+template <size_t Size>
+inline void php_bswap_array(const char *src, size_t n, char *dst) noexcept {
+    static_assert(Size == 2 || Size == 4 || Size == 8,
+                  "no byte swap kernel for this size");
+    const php_kernels &k = php_kernel_table();
+    if constexpr (Size == 2) {
+        k.bswap16(src, n, dst);
+    } else if constexpr (Size == 4) {
+        k.bswap32(src, n, dst);
+    } else {
+        k.bswap64(src, n, dst);
+    }
+}
+
+/* stores n native values of Size bytes in little or big endian order */
+template <size_t Size, bool Little>
+inline void php_store_array(const void *src, size_t n, char *dst) noexcept {
+    if (n == 0) {
+        return;
+    }
+    if constexpr (Size == 1 || Little == is_little_endian()) {
+        memcpy(dst, src, n * Size);
+    } else {
+        php_bswap_array<Size>(static_cast<const char *>(src), n, dst);
+    }
+}
+
+/* loads n values stored by php_store_array */
+template <size_t Size, bool Little>
+inline void php_load_array(const char *src, size_t n, void *dst) noexcept {
+    if (n == 0) {
+        return;
+    }
+    if constexpr (Size == 1 || Little == is_little_endian()) {
+        memcpy(dst, src, n * Size);
+    } else {
+        php_bswap_array<Size>(src, n, static_cast<char *>(dst));
+    }
+}
+
+} // namespace __phpack__detail
+
+} // namespace PhPacker
+
+#endif /* DISPATCH_H */
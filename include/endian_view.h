@@ -0,0 +1,188 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef ENDIAN_VIEW_H
+#define ENDIAN_VIEW_H
+
+#include "pack.h"
+
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace PhPacker {
+
+namespace __phpack__detail {
+
+/* the pack code with the same bytes as T stored in the given order */
+template <typename T, bool Little> constexpr char php_overlay_code() noexcept {
+    if constexpr (std::is_floating_point_v<T>) {
+        if constexpr (sizeof(T) == 4) {
+            return Little ? 'g' : 'G';
+        } else {
+            return Little ? 'e' : 'E';
+        }
+    } else if constexpr (sizeof(T) == 1) {
+        return std::is_signed_v<T> ? 'c' : 'C';
+    } else if constexpr (sizeof(T) == 2) {
+        return Little ? 'v' : 'n';
+    } else if constexpr (sizeof(T) == 4) {
+        return Little ? 'V' : 'N';
+    } else {
+        return Little ? 'P' : 'J';
+    }
+}
+
+} // namespace __phpack__detail
+
+/**
+ * @brief A value of type T stored in a fixed byte order
+ *
+ * Holds only the bytes, so it has alignment 1 and no padding and can be
+ * laid over packed data. The bytes are converted when the value is read or
+ * written. Structs of endian values mirror pack formats field for field.
+ */
+template <typename T, bool Little> class endian_value {
+    static_assert(std::is_arithmetic_v<T> &&
+                      (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 ||
+                       sizeof(T) == 8),
+                  "endian_value needs an arithmetic type of 1, 2, 4 or 8 bytes");
+
+  public:
+    using value_type = T;
+    static constexpr bool little = Little;
+    static constexpr char code = __phpack__detail::php_overlay_code<T, Little>();
+
+    endian_value() = default;
+    endian_value(T value) noexcept { set(value); }
+
+    T get() const noexcept {
+        using namespace __phpack__detail;
+        const uint64_t v = php_load_uint<sizeof(T), Little>(m_bytes);
+        if constexpr (std::is_floating_point_v<T>) {
+            const bits_type bits = php_narrow<bits_type>(v);
+            T value{};
+            memcpy(&value, &bits, sizeof(T));
+            return value;
+        } else {
+            return php_narrow<T>(v);
+        }
+    }
+
+    void set(T value) noexcept {
+        using namespace __phpack__detail;
+        if constexpr (std::is_floating_point_v<T>) {
+            bits_type bits{};
+            memcpy(&bits, &value, sizeof(T));
+            php_store_uint<sizeof(T), Little>(bits, m_bytes);
+        } else {
+            php_store_uint<sizeof(T), Little>(php_narrow<uint64_t>(value),
+                                              m_bytes);
+        }
+    }
+
+    operator T() const noexcept { return get(); }
+
+    endian_value &operator=(T value) noexcept {
+        set(value);
+        return *this;
+    }
+
+    const char *data() const noexcept { return m_bytes; }
+
+  private:
+    using bits_type = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+
+    char m_bytes[sizeof(T)];
+};
+
+using u8 = endian_value<uint8_t, true>;        // C
+using i8 = endian_value<int8_t, true>;         // c
+using be_u16 = endian_value<uint16_t, false>;  // n
+using le_u16 = endian_value<uint16_t, true>;   // v
+using be_i16 = endian_value<int16_t, false>;
+using le_i16 = endian_value<int16_t, true>;
+using be_u32 = endian_value<uint32_t, false>;  // N
+using le_u32 = endian_value<uint32_t, true>;   // V
+using be_i32 = endian_value<int32_t, false>;
+using le_i32 = endian_value<int32_t, true>;
+using be_u64 = endian_value<uint64_t, false>;  // J
+using le_u64 = endian_value<uint64_t, true>;   // P
+using be_i64 = endian_value<int64_t, false>;
+using le_i64 = endian_value<int64_t, true>;
+using be_f32 = endian_value<float, false>;     // G
+using le_f32 = endian_value<float, true>;      // g
+using be_f64 = endian_value<double, false>;    // E
+using le_f64 = endian_value<double, true>;     // e
+
+/**
+ * @brief the pack format of a struct made of the given endian values, e.g.
+ * overlay_format<be_u32, be_u16, u8> is "NnC"
+ */
+template <typename... Fields>
+inline constexpr char overlay_format[] = {Fields::code..., '\0'};
+
+template <typename T> constexpr bool is_overlay_v =
+    std::is_trivially_copyable_v<T> && std::is_standard_layout_v<T> &&
+    alignof(T) == 1;
+
+/**
+ * @brief view packed data in place as T, a struct of endian values
+ */
+template <typename T> const T *overlay(const char *data) noexcept {
+    static_assert(is_overlay_v<T>,
+                  "overlay needs a trivially copyable type with alignment 1");
+    return std::launder(reinterpret_cast<const T *>(data));
+}
+
+template <typename T> T *overlay(char *data) noexcept {
+    static_assert(is_overlay_v<T>,
+                  "overlay needs a trivially copyable type with alignment 1");
+    return std::launder(reinterpret_cast<T *>(data));
+}
+
+/**
+ * @brief view the index-th T in data
+ * @throw std::out_of_range if data is too short
+ */
+template <typename T>
+const T *overlay(std::string_view data, size_t index = 0) {
+    if (index >= data.size() / sizeof(T)) {
+        throw std::out_of_range("overlay: record " + std::to_string(index) +
+                                " is past the end of the data");
+    }
+    return overlay<T>(data.data() + index * sizeof(T));
+}
+
+} // namespace PhPacker
+
+#endif /* ENDIAN_VIEW_H */
@@ -0,0 +1,636 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "format.h"
+#include "bitfield.h"
+#include "dispatch.h"
+
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace PhPacker {
+
+namespace __phpack__detail {
+
+template <char Code>
+void php_store_field(const php_pack_arg &arg, char *dst) noexcept {
+    constexpr size_t size = php_pack_code_size(Code);
+    constexpr bool little = php_code_is_little(Code);
+
+    if constexpr (Code == 'f' || Code == 'g' || Code == 'G') {
+        const float f = static_cast<float>(php_arg_to_double(arg));
+        uint32_t bits{};
+        memcpy(&bits, &f, sizeof(float));
+        php_store_uint<size, little>(bits, dst);
+    } else if constexpr (Code == 'd' || Code == 'e' || Code == 'E') {
+        const double d = php_arg_to_double(arg);
+        uint64_t bits{};
+        memcpy(&bits, &d, sizeof(double));
+        php_store_uint<size, little>(bits, dst);
+    } else {
+        php_store_uint<size, little>(php_arg_to_uint(arg), dst);
+    }
+}
+
+template <char Code> std::any php_load_field(const char *src) {
+    constexpr size_t size = php_pack_code_size(Code);
+    constexpr bool little = php_code_is_little(Code);
+    const uint64_t v = php_load_uint<size, little>(src);
+
+    if constexpr (Code == 'f' || Code == 'g' || Code == 'G') {
+        const uint32_t bits = static_cast<uint32_t>(v);
+        float f{};
+        memcpy(&f, &bits, sizeof(float));
+        return f;
+    } else if constexpr (Code == 'd' || Code == 'e' || Code == 'E') {
+        double d{};
+        memcpy(&d, &v, sizeof(double));
+        return d;
+    } else if constexpr (Code == 'c') {
+        return static_cast<signed char>(v);
+    } else if constexpr (Code == 'C') {
+        return static_cast<unsigned char>(v);
+    } else if constexpr (Code == 's') {
+        return static_cast<short>(v);
+    } else if constexpr (Code == 'S' || Code == 'n' || Code == 'v') {
+        return static_cast<unsigned short>(v);
+    } else if constexpr (Code == 'i') {
+        return static_cast<int>(v);
+    } else if constexpr (Code == 'I') {
+        return static_cast<unsigned int>(v);
+    } else if constexpr (Code == 'l') {
+        return static_cast<int32_t>(v);
+    } else if constexpr (Code == 'L' || Code == 'N' || Code == 'V') {
+        return static_cast<uint32_t>(v);
+    } else if constexpr (Code == 'q') {
+        return static_cast<int64_t>(v);
+    } else {
+        return v;
+    }
+}
+
+template <char Code>
+bool php_codec(php_store_fn &store, php_load_fn &load) noexcept {
+    store = &php_store_field<Code>;
+    load = &php_load_field<Code>;
+    return true;
+}
+
+bool php_resolve_codec(char code, php_store_fn &store,
+                       php_load_fn &load) noexcept {
+    switch (code) {
+    case 'c':
+        return php_codec<'c'>(store, load);
+    case 'C':
+        return php_codec<'C'>(store, load);
+    case 's':
+        return php_codec<'s'>(store, load);
+    case 'S':
+        return php_codec<'S'>(store, load);
+    case 'n':
+        return php_codec<'n'>(store, load);
+    case 'v':
+        return php_codec<'v'>(store, load);
+    case 'i':
+        return php_codec<'i'>(store, load);
+    case 'I':
+        return php_codec<'I'>(store, load);
+    case 'l':
+        return php_codec<'l'>(store, load);
+    case 'L':
+        return php_codec<'L'>(store, load);
+    case 'N':
+        return php_codec<'N'>(store, load);
+    case 'V':
+        return php_codec<'V'>(store, load);
+#if SIZEOF_LONG > 4
+    case 'q':
+        return php_codec<'q'>(store, load);
+    case 'Q':
+        return php_codec<'Q'>(store, load);
+    case 'J':
+        return php_codec<'J'>(store, load);
+    case 'P':
+        return php_codec<'P'>(store, load);
+#endif
+    case 'f':
+        return php_codec<'f'>(store, load);
+    case 'g':
+        return php_codec<'g'>(store, load);
+    case 'G':
+        return php_codec<'G'>(store, load);
+    case 'd':
+        return php_codec<'d'>(store, load);
+    case 'e':
+        return php_codec<'e'>(store, load);
+    case 'E':
+        return php_codec<'E'>(store, load);
+    }
+    return false;
+}
+
+std::string php_type_error(char code, const std::string &what) {
+    return std::string("Type ") + code + ": " + what;
+}
+
+inline int php_hex_value(char c) noexcept {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+size_t php_pack_string_size(const FormatField &field,
+                            std::string_view value) noexcept {
+    if (!field.star) {
+        return field.size;
+    }
+    switch (field.code) {
+    case 'Z':
+        return value.size() + 1;
+    case 'h':
+    case 'H':
+        return (value.size() + 1) / 2;
+    }
+    return value.size();
+}
+
+void php_pack_string(const FormatField &field, std::string_view value,
+                     char *dst) noexcept {
+    const size_t size = php_pack_string_size(field, value);
+
+    switch (field.code) {
+    case 'a':
+    case 'A':
+    case 'Z': {
+        /* Z always keeps room for the terminating NUL */
+        const size_t room = field.code == 'Z' && size > 0 ? size - 1 : size;
+        const size_t n = value.size() < room ? value.size() : room;
+        /* an empty string_view may have a null data() */
+        if (n) {
+            memcpy(dst, value.data(), n);
+        }
+        memset(dst + n, field.code == 'A' ? ' ' : '\0', size - n);
+        break;
+    }
+    case 'h':
+    case 'H': {
+        const size_t nibbles =
+            field.star || value.size() < field.count ? value.size()
+                                                     : field.count;
+        /* check_args() rejected anything but hex digits */
+        const size_t packed = (nibbles + 1) / 2;
+        php_kernel_table().hex_decode(value.data(), nibbles, dst,
+                                      field.code == 'H');
+        memset(dst + packed, 0, size - packed);
+        break;
+    }
+    }
+}
+
+void php_pack_bits(const FormatField &field, const php_pack_arg &arg,
+                   char *dst) noexcept {
+    const bool little = field.code == 'b';
+    uint64_t word = php_load_bytes(dst, field.size, little);
+    word |= (php_arg_to_uint(arg) & php_bit_mask(field.bits)) << field.shift;
+    php_store_bytes(word, field.size, little, dst);
+}
+
+namespace {
+
+/* value bits of an integer field, the sign bit not included */
+unsigned php_field_digits(const FormatField &field) noexcept {
+    if (field.is_bits()) {
+        return field.bits;
+    }
+    const auto bits = static_cast<unsigned>(php_pack_code_size(field.code) * 8);
+    return php_code_is_signed(field.code) ? bits - 1 : bits;
+}
+
+uint64_t php_digits_max(unsigned digits) noexcept {
+    return digits >= 64 ? ~uint64_t{0} : (uint64_t{1} << digits) - 1;
+}
+
+} // namespace
+
+bool php_arg_fits(const FormatField &field, const php_pack_arg &arg) noexcept {
+    if (!field.is_bits() && php_pack_code_is_float(field.code)) {
+        if (field.size != sizeof(float) || arg.kind != php_pack_arg::Float) {
+            return true;
+        }
+        const double max = std::numeric_limits<float>::max();
+        return !(arg.d > max || arg.d < -max) || std::isinf(arg.d);
+    }
+
+    const bool is_signed = !field.is_bits() && php_code_is_signed(field.code);
+    const unsigned digits = php_field_digits(field);
+    switch (arg.kind) {
+    case php_pack_arg::Signed: {
+        const auto v = static_cast<int64_t>(arg.i);
+        if (v < 0) {
+            return is_signed &&
+                   (digits >= 63 || v >= -static_cast<int64_t>(
+                                             php_digits_max(digits)) - 1);
+        }
+        return arg.i <= php_digits_max(digits);
+    }
+    case php_pack_arg::Unsigned:
+        return arg.i <= php_digits_max(digits);
+    case php_pack_arg::Float: {
+        const double limit = std::ldexp(1.0, static_cast<int>(digits));
+        return arg.d >= (is_signed ? -limit : 0.0) && arg.d < limit;
+    }
+    case php_pack_arg::String:
+        break;
+    }
+    return true;
+}
+
+php_pack_arg php_saturate_arg(const FormatField &field,
+                              const php_pack_arg &arg) noexcept {
+    if (php_arg_fits(field, arg)) {
+        return arg;
+    }
+
+    php_pack_arg result = arg;
+    if (!field.is_bits() && php_pack_code_is_float(field.code)) {
+        result.d = std::copysign(std::numeric_limits<float>::max(), arg.d);
+        return result;
+    }
+
+    const bool is_signed = !field.is_bits() && php_code_is_signed(field.code);
+    const uint64_t max = php_digits_max(php_field_digits(field));
+    const bool negative =
+        arg.kind == php_pack_arg::Float
+            ? arg.d < 0
+            : arg.kind == php_pack_arg::Signed &&
+                  static_cast<int64_t>(arg.i) < 0;
+    if (arg.kind == php_pack_arg::Float && std::isnan(arg.d)) {
+        result = {php_pack_arg::Unsigned, 0, 0.0, {}};
+    } else if (!negative) {
+        result = {php_pack_arg::Unsigned, max, 0.0, {}};
+    } else if (is_signed) {
+        result = {php_pack_arg::Signed, ~max, 0.0, {}};
+    } else {
+        result = {php_pack_arg::Unsigned, 0, 0.0, {}};
+    }
+    return result;
+}
+
+uint64_t php_unpack_bits(const FormatField &field, const char *src) noexcept {
+    const uint64_t word = php_load_bytes(src, field.size, field.code == 'b');
+    return (word >> field.shift) & php_bit_mask(field.bits);
+}
+
+std::string php_unpack_string(char code, std::string_view bytes,
+                              size_t nibbles) {
+    switch (code) {
+    case 'A': {
+        /* trailing whitespace and NULs are stripped */
+        const auto end =
+            bytes.find_last_not_of(std::string_view(" \t\r\n\0", 5));
+        return std::string(
+            bytes.substr(0, end == std::string_view::npos ? 0 : end + 1));
+    }
+    case 'Z':
+        /* everything up to the first NUL */
+        return std::string(bytes.substr(0, bytes.find('\0')));
+    case 'h':
+    case 'H': {
+        std::string hex(nibbles, '\0');
+        php_kernel_table().hex_encode(bytes.data(), nibbles, &hex[0],
+                                      code == 'H');
+        return hex;
+    }
+    }
+    return std::string(bytes);
+}
+
+std::any php_unpack_field(const FormatField &field, std::string_view bytes) {
+    if (field.load) {
+        return field.load(bytes.data());
+    }
+    if (field.is_bits()) {
+        return php_unpack_bits(field, bytes.data());
+    }
+    const size_t nibbles = field.star ? bytes.size() * 2 : field.count;
+    return php_unpack_string(field.code, bytes, nibbles);
+}
+
+} // namespace __phpack__detail
+
+Format::Format(std::string_view format, Conversion conversion)
+    : m_format(format), m_conversion(conversion) {
+    using namespace __phpack__detail;
+
+    /* bit fields are grouped until the code changes or 64 bits are used */
+    size_t group = 0;
+    unsigned group_bits = 0;
+    auto close_group = [&] {
+        if (group_bits == 0) {
+            return;
+        }
+        const size_t bytes = (group_bits + 7) / 8;
+        for (size_t f = group; f < m_fields.size(); ++f) {
+            FormatField &field = m_fields[f];
+            const BitOrder order =
+                field.code == 'B' ? BitOrder::MsbFirst : BitOrder::LsbFirst;
+            field.size = bytes;
+            /* shift holds the bits before the field until now */
+            field.shift = php_bit_shift(order, field.shift, field.bits, bytes);
+        }
+        m_size += bytes;
+        group_bits = 0;
+    };
+
+    size_t i = 0;
+    while (i < format.size()) {
+        const char code = format[i++];
+        php_store_fn store = nullptr;
+        php_load_fn load = nullptr;
+
+        const bool numeric = php_resolve_codec(code, store, load);
+        const bool string = code == 'a' || code == 'A' || code == 'Z' ||
+                            code == 'h' || code == 'H';
+        const bool bits = code == 'b' || code == 'B';
+        if (code == 'X' || code == '@') {
+            throw std::invalid_argument(
+                php_type_error(code, "not supported by Format"));
+        }
+        if (!numeric && !string && !bits && code != 'x') {
+            throw std::invalid_argument(
+                php_type_error(code, "unknown format code"));
+        }
+
+        size_t count = 1;
+        bool star = false;
+        if (i < format.size() && format[i] == '*') {
+            if (numeric || bits) {
+                throw std::invalid_argument(
+                    php_type_error(code, "'*' repeater is not supported"));
+            }
+            /* php ignores '*' for x */
+            star = string;
+            ++i;
+        } else if (i < format.size() && format[i] >= '0' && format[i] <= '9') {
+            count = 0;
+            while (i < format.size() && format[i] >= '0' && format[i] <= '9') {
+                count = count * 10 + static_cast<size_t>(format[i++] - '0');
+                if (count > INT_MAX) {
+                    throw std::invalid_argument(
+                        php_type_error(code, "integer overflow"));
+                }
+            }
+        }
+
+        if (bits) {
+            if (count == 0 || count > 64) {
+                throw std::invalid_argument(
+                    php_type_error(code, "bit width must be 1 to 64"));
+            }
+            const auto width = static_cast<unsigned>(count);
+            if (group_bits != 0 && (m_fields[group].code != code ||
+                                    group_bits + width > 64)) {
+                close_group();
+            }
+            if (group_bits == 0) {
+                group = m_fields.size();
+            }
+            m_fields.push_back(
+                {code, m_size, 0, 1, false, nullptr, nullptr, width, group_bits});
+            group_bits += width;
+            ++m_args;
+            continue;
+        }
+        close_group();
+
+        if (numeric) {
+            const size_t size = php_pack_code_size(code);
+            for (size_t n = 0; n < count; ++n) {
+                m_fields.push_back(
+                    {code, m_size, size, 1, false, store, load, 0, 0});
+                m_size += size;
+            }
+            m_args += count;
+            continue;
+        }
+
+        size_t size = count;
+        if (star) {
+            size = 0;
+            m_fixed = false;
+        } else if (code == 'h' || code == 'H') {
+            size = (count + 1) / 2;
+        }
+        m_fields.push_back(
+            {code, m_size, size, count, star, nullptr, nullptr, 0, 0});
+        m_size += size;
+        if (string) {
+            ++m_args;
+        }
+    }
+    close_group();
+}
+
+void Format::check_args(const __phpack__detail::php_pack_arg *argv,
+                        size_t argc) const {
+    using namespace __phpack__detail;
+
+    size_t a = 0;
+    for (const FormatField &field : m_fields) {
+        if (!field.takes_value()) {
+            continue;
+        }
+        if (a == argc) {
+            throw std::invalid_argument(
+                php_type_error(field.code, "too few arguments"));
+        }
+
+        const php_pack_arg &arg = argv[a++];
+        if (field.is_string() != (arg.kind == php_pack_arg::String)) {
+            throw std::invalid_argument(php_type_error(
+                field.code, field.is_string() ? "expected a string"
+                                              : "expected a number"));
+        }
+        if (m_conversion == Conversion::Check && !php_arg_fits(field, arg)) {
+            throw RangeError(field.code, a - 1);
+        }
+        if (field.code == 'h' || field.code == 'H') {
+            for (char c : arg.s) {
+                if (php_hex_value(c) < 0) {
+                    throw std::invalid_argument(php_type_error(
+                        field.code, std::string("illegal hex digit ") + c));
+                }
+            }
+        }
+    }
+    if (argc > a) {
+        throw std::invalid_argument(std::to_string(argc - a) +
+                                    " arguments unused");
+    }
+}
+
+void Format::pack_args(const __phpack__detail::php_pack_arg *argv, size_t argc,
+                       std::string &output) const {
+    output.resize(args_size(argv, argc));
+    store_args(argv, &output[0]);
+}
+
+size_t Format::args_size(const __phpack__detail::php_pack_arg *argv,
+                         size_t argc) const {
+    using namespace __phpack__detail;
+
+    check_args(argv, argc);
+
+    size_t size = m_size;
+    if (!m_fixed) {
+        size_t a = 0;
+        for (const FormatField &field : m_fields) {
+            if (field.star) {
+                size += php_pack_string_size(field, argv[a].s);
+            }
+            if (field.takes_value()) {
+                ++a;
+            }
+        }
+    }
+    return size;
+}
+
+void Format::store_args(const __phpack__detail::php_pack_arg *argv,
+                        char *out) const noexcept {
+    using namespace __phpack__detail;
+
+    size_t extra = 0;
+    size_t a = 0;
+    for (const FormatField &field : m_fields) {
+        char *dst = out + field.offset + extra;
+        if (field.takes_value() && !field.is_string() &&
+            m_conversion == Conversion::Saturate) {
+            const php_pack_arg arg = php_saturate_arg(field, argv[a++]);
+            if (field.store) {
+                field.store(arg, dst);
+            } else {
+                php_pack_bits(field, arg, dst);
+            }
+        } else if (field.store) {
+            field.store(argv[a++], dst);
+        } else if (field.is_bits()) {
+            php_pack_bits(field, argv[a++], dst);
+        } else if (field.is_string()) {
+            php_pack_string(field, argv[a].s, dst);
+            if (field.star) {
+                extra += php_pack_string_size(field, argv[a].s);
+            }
+            ++a;
+        } else {
+            memset(dst, 0, field.size);
+        }
+    }
+}
+
+std::vector<std::any> Format::unpack(std::string_view data) const {
+    using namespace __phpack__detail;
+
+    std::vector<std::any> result;
+    result.reserve(m_args);
+    size_t extra = 0;
+    for (const FormatField &field : m_fields) {
+        const size_t pos = field.offset + extra;
+        size_t size = field.size;
+        if (field.star) {
+            size = pos < data.size() ? data.size() - pos : 0;
+            extra += size;
+        }
+
+        if (pos + size > data.size()) {
+            const size_t have = pos < data.size() ? data.size() - pos : 0;
+            throw std::out_of_range(php_type_error(
+                field.code, "not enough input, need " + std::to_string(size) +
+                                ", have " + std::to_string(have)));
+        }
+
+        if (field.takes_value()) {
+            result.push_back(php_unpack_field(field, data.substr(pos, size)));
+        }
+    }
+    return result;
+}
+
+FormatCache::FormatCache(size_t capacity)
+    : m_capacity(capacity > 0 ? capacity : 1) {}
+
+const Format &FormatCache::get(std::string_view format) {
+    auto it = m_index.find(format);
+    if (it != m_index.end()) {
+        ++m_hits;
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return *it->second;
+    }
+
+    ++m_misses;
+    m_entries.emplace_front(format);
+    try {
+        m_index.emplace(m_entries.front().str(), m_entries.begin());
+    } catch (...) {
+        m_entries.pop_front();
+        throw;
+    }
+
+    if (m_entries.size() > m_capacity) {
+        m_index.erase(m_entries.back().str());
+        m_entries.pop_back();
+    }
+    return m_entries.front();
+}
+
+void FormatCache::clear() noexcept {
+    m_index.clear();
+    m_entries.clear();
+}
+
+FormatCache &thread_format_cache() {
+    static thread_local FormatCache cache;
+    return cache;
+}
+
+std::vector<std::any> unpack(std::string_view format, std::string_view data) {
+    return thread_format_cache().get(format).unpack(data);
+}
+
+} // namespace PhPacker
@@ -0,0 +1,365 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include "pack.h"
+
+#include <any>
+#include <array>
+#include <cstring>
+#include <list>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace PhPacker {
+
+namespace __phpack__detail {
+
+/* a single pack() argument, converted once to what the codes need */
+struct php_pack_arg {
+    enum kind_t { Unsigned, Signed, Float, String };
+
+    kind_t kind;
+    uint64_t i;
+    double d;
+    std::string_view s;
+};
+
+template <typename T,
+          typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+php_pack_arg php_make_pack_arg(const T val) noexcept {
+    if constexpr (std::is_floating_point<T>::value) {
+        return {php_pack_arg::Float, 0, static_cast<double>(val), {}};
+    } else if constexpr (std::is_signed<T>::value) {
+        return {php_pack_arg::Signed,
+                static_cast<uint64_t>(static_cast<int64_t>(val)), 0.0, {}};
+    } else {
+        return {php_pack_arg::Unsigned, static_cast<uint64_t>(val), 0.0, {}};
+    }
+}
+
+/* strings are referenced, not copied */
+inline php_pack_arg php_make_pack_arg(std::string_view val) noexcept {
+    return {php_pack_arg::String, 0, 0.0, val};
+}
+
+/* what integer and float codes store for a numeric arg */
+inline uint64_t php_arg_to_uint(const php_pack_arg &arg) noexcept {
+    if (arg.kind == php_pack_arg::Float) {
+        return php_double_to_uint(arg.d);
+    }
+    return arg.i;
+}
+
+inline double php_arg_to_double(const php_pack_arg &arg) noexcept {
+    switch (arg.kind) {
+    case php_pack_arg::Float:
+        return arg.d;
+    case php_pack_arg::Signed:
+        return static_cast<double>(static_cast<int64_t>(arg.i));
+    case php_pack_arg::Unsigned:
+    case php_pack_arg::String:
+        break;
+    }
+    return static_cast<double>(arg.i);
+}
+
+using php_store_fn = void (*)(const php_pack_arg &, char *) noexcept;
+using php_load_fn = std::any (*)(const char *);
+
+/* codec of a numeric code, false if the code is not numeric */
+bool php_resolve_codec(char code, php_store_fn &store,
+                       php_load_fn &load) noexcept;
+
+std::string php_type_error(char code, const std::string &what);
+
+} // namespace __phpack__detail
+
+/**
+ * @brief A single packed value inside a Format
+ *
+ * Repeat counts of numeric codes are expanded, so "n2" yields two fields
+ * while "a5" is one five byte string field. Consecutive bit fields share
+ * the offset and size of their group.
+ */
+struct FormatField {
+    char code;
+    /* bytes before this field, not counting the value of '*' fields */
+    size_t offset;
+    /* 0 for '*' fields, whose size depends on the value */
+    size_t size;
+    /* bytes of a, A, Z and x, nibbles of h and H, 1 otherwise */
+    size_t count;
+    bool star;
+    /* numeric codes only */
+    __phpack__detail::php_store_fn store;
+    __phpack__detail::php_load_fn load;
+    /* width and position of b and B fields inside their group, 0 otherwise */
+    unsigned bits;
+    unsigned shift;
+
+    bool is_string() const noexcept {
+        return code == 'a' || code == 'A' || code == 'Z' || code == 'h' ||
+               code == 'H';
+    }
+    bool is_bits() const noexcept { return bits != 0; }
+    /* x packs NUL bytes and takes no value */
+    bool takes_value() const noexcept { return code != 'x'; }
+};
+
+namespace __phpack__detail {
+
+/* bytes packed for the value of a string field */
+size_t php_pack_string_size(const FormatField &field,
+                            std::string_view value) noexcept;
+
+/* packs a string field into php_pack_string_size() bytes at dst */
+void php_pack_string(const FormatField &field, std::string_view value,
+                     char *dst) noexcept;
+
+/* ORs the value of a bit field into its zero initialized group at dst */
+void php_pack_bits(const FormatField &field, const php_pack_arg &arg,
+                   char *dst) noexcept;
+
+uint64_t php_unpack_bits(const FormatField &field, const char *src) noexcept;
+
+/* true if arg fits the field without wrapping, bit fields are unsigned */
+bool php_arg_fits(const FormatField &field, const php_pack_arg &arg) noexcept;
+
+/* arg clamped to the field for Conversion::Saturate */
+php_pack_arg php_saturate_arg(const FormatField &field,
+                              const php_pack_arg &arg) noexcept;
+
+/* the unpacked value of a string field stored in bytes */
+std::string php_unpack_string(char code, std::string_view bytes,
+                              size_t nibbles);
+
+/* the unpacked value of a field that takes one, stored in bytes */
+std::any php_unpack_field(const FormatField &field, std::string_view bytes);
+
+} // namespace __phpack__detail
+
+/**
+ * @brief A parsed pack()/unpack() format string
+ *
+ * Parsing resolves every code to its offset, size and codec once, so
+ * packing with a Format only walks the field table.
+ */
+class Format {
+  public:
+    /**
+     * @brief Format
+     * @param format e.g. "nVC4" or "na*", X and @ are not supported.
+     * As an extension b<bits> and B<bits> pack bit fields, LSB and MSB
+     * first, consecutive ones share bytes. See BitOrder.
+     * @param conversion what pack() does with numbers that don't fit
+     * their field
+     * @throw std::invalid_argument for unknown codes or bad repeat counts
+     */
+    explicit Format(std::string_view format,
+                    Conversion conversion = Conversion::Wrap);
+
+    const std::string &str() const noexcept { return m_format; }
+    const std::vector<FormatField> &fields() const noexcept { return m_fields; }
+
+    /**
+     * @brief size
+     * @return number of bytes produced by pack(), excluding '*' fields
+     */
+    size_t size() const noexcept { return m_size; }
+
+    /**
+     * @brief fixed
+     * @return true if every field has a static offset and size
+     */
+    bool fixed() const noexcept { return m_fixed; }
+
+    /**
+     * @brief number of values pack() takes
+     */
+    size_t args() const noexcept { return m_args; }
+
+    Conversion conversion() const noexcept { return m_conversion; }
+
+    /**
+     * @brief check that argv matches the fields that take a value
+     * @throw std::invalid_argument on a count or type mismatch
+     * @throw RangeError with the argument index for Conversion::Check
+     */
+    void check_args(const __phpack__detail::php_pack_arg *argv,
+                    size_t argc) const;
+
+    /**
+     * @brief pack one value per field, strings for a, A, Z, h and H
+     * @return string
+     * @throw std::invalid_argument if the arguments do not match
+     */
+    template <typename... Args> std::string pack(const Args &...args) const {
+        using namespace __phpack__detail;
+        std::array<php_pack_arg, sizeof...(Args)> argv = {
+            {php_make_pack_arg(args)...}};
+        std::string output;
+        pack_args(argv.data(), argv.size(), output);
+        return output;
+    }
+
+    /**
+     * @brief number of bytes pack() produces for these arguments
+     * @throw std::invalid_argument if the arguments do not match
+     */
+    template <typename... Args>
+    size_t packed_size(const Args &...args) const {
+        using namespace __phpack__detail;
+        std::array<php_pack_arg, sizeof...(Args)> argv = {
+            {php_make_pack_arg(args)...}};
+        return args_size(argv.data(), argv.size());
+    }
+
+    /**
+     * @brief pack into caller memory instead of a new string
+     * @param out
+     * @param capacity bytes available at out
+     * @return number of bytes written
+     * @throw std::invalid_argument if the arguments do not match
+     * @throw std::length_error if they need more than capacity bytes
+     */
+    template <typename... Args>
+    size_t pack_to(char *out, size_t capacity, const Args &...args) const {
+        using namespace __phpack__detail;
+        std::array<php_pack_arg, sizeof...(Args)> argv = {
+            {php_make_pack_arg(args)...}};
+        const size_t size = args_size(argv.data(), argv.size());
+        if (size > capacity) {
+            throw std::length_error("Format::pack_to: needs " +
+                                    std::to_string(size) + " bytes, has " +
+                                    std::to_string(capacity));
+        }
+        /* bit fields are ORed into zeroed groups */
+        memset(out, 0, size);
+        store_args(argv.data(), out);
+        return size;
+    }
+
+    /**
+     * @brief unpack every field
+     * @param data
+     * @return one value per field, typed like unpack(char, ...),
+     * std::string for string fields and uint64_t for bit fields. A '*'
+     * field takes the rest of data.
+     * @throw std::out_of_range if data is shorter than size()
+     */
+    std::vector<std::any> unpack(std::string_view data) const;
+
+  private:
+    void pack_args(const __phpack__detail::php_pack_arg *argv, size_t argc,
+                   std::string &output) const;
+    /* checks argv and returns the packed size */
+    size_t args_size(const __phpack__detail::php_pack_arg *argv,
+                     size_t argc) const;
+    void store_args(const __phpack__detail::php_pack_arg *argv,
+                    char *out) const noexcept;
+
+    std::string m_format;
+    std::vector<FormatField> m_fields;
+    size_t m_size = 0;
+    size_t m_args = 0;
+    bool m_fixed = true;
+    Conversion m_conversion;
+};
+
+/**
+ * @brief Bounded LRU cache of parsed formats
+ *
+ * Not thread safe, use thread_format_cache() to get one per thread.
+ */
+class FormatCache {
+  public:
+    static constexpr size_t default_capacity = 256;
+
+    explicit FormatCache(size_t capacity = default_capacity);
+
+    FormatCache(const FormatCache &) = delete;
+    FormatCache &operator=(const FormatCache &) = delete;
+
+    /**
+     * @brief get the parsed format, parsing it on a miss
+     * @param format
+     * @return reference valid until the next get() or clear()
+     */
+    const Format &get(std::string_view format);
+
+    size_t hits() const noexcept { return m_hits; }
+    size_t misses() const noexcept { return m_misses; }
+    size_t size() const noexcept { return m_entries.size(); }
+    size_t capacity() const noexcept { return m_capacity; }
+
+    void clear() noexcept;
+
+  private:
+    /* most recently used first */
+    std::list<Format> m_entries;
+    /* keys point into Format::str() of the list entries */
+    std::unordered_map<std::string_view, std::list<Format>::iterator> m_index;
+    size_t m_capacity;
+    size_t m_hits = 0;
+    size_t m_misses = 0;
+};
+
+/**
+ * @brief the calling thread's format cache
+ */
+FormatCache &thread_format_cache();
+
+/**
+ * @brief pack several values, e.g. pack("nV", 1, 2)
+ * @param format parsed once per thread and cached
+ * @param args
+ * @return string
+ */
+template <typename... Args>
+std::string pack(std::string_view format, const Args &...args) {
+    return thread_format_cache().get(format).pack(args...);
+}
+
+/**
+ * @brief unpack several values, e.g. unpack("nV", data)
+ * @param format parsed once per thread and cached
+ * @param data
+ * @return one value per field
+ */
+std::vector<std::any> unpack(std::string_view format, std::string_view data);
+
+} // namespace PhPacker
+
+#endif /* FORMAT_H */
@@ -0,0 +1,156 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "gather.h"
+#include "crc32c.h"
+
+#include <cstring>
+
+namespace PhPacker {
+
+char *GatherOutput::header(size_t size) {
+    if (m_segments.empty() || m_segments.back().ref) {
+        m_segments.push_back({nullptr, m_header.size(), 0});
+    }
+    m_segments.back().size += size;
+    m_size += size;
+    m_header.resize(m_header.size() + size);
+    return &m_header[m_header.size() - size];
+}
+
+void GatherOutput::reference(const char *data, size_t size) {
+    m_segments.push_back({data, 0, size});
+    m_size += size;
+}
+
+void GatherOutput::append(const Format &format,
+                          const __phpack__detail::php_pack_arg *argv,
+                          size_t argc) {
+    using namespace __phpack__detail;
+
+    format.check_args(argv, argc);
+
+    size_t a = 0;
+    /* header position of the current group of bit fields */
+    const FormatField *group = nullptr;
+    size_t group_pos = 0;
+    const bool saturate = format.conversion() == Conversion::Saturate;
+    for (const FormatField &field : format.fields()) {
+        if (field.store) {
+            field.store(saturate ? php_saturate_arg(field, argv[a]) : argv[a],
+                        header(field.size));
+            ++a;
+            continue;
+        }
+        if (field.is_bits()) {
+            if (!group || group->offset != field.offset) {
+                group = &field;
+                group_pos = m_header.size();
+                header(field.size);
+            }
+            php_pack_bits(field,
+                          saturate ? php_saturate_arg(field, argv[a]) : argv[a],
+                          &m_header[group_pos]);
+            ++a;
+            continue;
+        }
+        group = nullptr;
+        if (!field.is_string()) {
+            memset(header(field.size), 0, field.size);
+            continue;
+        }
+
+        const std::string_view value = argv[a++].s;
+        const size_t size = php_pack_string_size(field, value);
+        /* bytes of value that are packed, fixed fields truncate it */
+        const size_t room = field.code == 'Z' && size > 0 ? size - 1 : size;
+        const size_t n = value.size() < room ? value.size() : room;
+        if (field.code == 'h' || field.code == 'H' || n < m_threshold) {
+            php_pack_string(field, value, header(size));
+            continue;
+        }
+
+        /* the string itself is referenced, its padding goes to the header */
+        reference(value.data(), n);
+        if (size > n) {
+            memset(header(size - n), field.code == 'A' ? ' ' : '\0', size - n);
+        }
+    }
+}
+
+void GatherOutput::append_crc32c(char code) {
+    using namespace __phpack__detail;
+    php_check_trailer(code);
+
+    uint32_t crc = 0;
+    for (size_t i = m_crc_segment; i < m_segments.size(); ++i) {
+        const segment &s = m_segments[i];
+        const char *base = s.ref ? s.ref : m_header.data() + s.offset;
+        const size_t skip = i == m_crc_segment ? m_crc_skip : 0;
+        crc = crc32c(base + skip, s.size - skip, crc);
+    }
+
+    char *trailer = header(4);
+    if (code == 'N') {
+        php_store_uint<4, false>(crc, trailer);
+    } else {
+        php_store_uint<4, true>(crc, trailer);
+    }
+    m_crc_segment = m_segments.size() - 1;
+    m_crc_skip = m_segments.back().size;
+}
+
+const std::vector<IoVec> &GatherOutput::iov() {
+    m_iov.clear();
+    m_iov.reserve(m_segments.size());
+    for (const segment &s : m_segments) {
+        const char *base = s.ref ? s.ref : m_header.data() + s.offset;
+        m_iov.push_back({const_cast<char *>(base), s.size});
+    }
+    return m_iov;
+}
+
+std::string GatherOutput::str() const {
+    std::string output;
+    output.reserve(m_size);
+    for (const segment &s : m_segments) {
+        output.append(s.ref ? s.ref : m_header.data() + s.offset, s.size);
+    }
+    return output;
+}
+
+void GatherOutput::clear() noexcept {
+    m_header.clear();
+    m_segments.clear();
+    m_iov.clear();
+    m_crc_segment = 0;
+    m_crc_skip = 0;
+    m_size = 0;
+}
+
+} // namespace PhPacker
@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef GATHER_H
+#define GATHER_H
+
+#include "format.h"
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
+namespace PhPacker {
+
+#ifdef _WIN32
+struct IoVec {
+    void *iov_base;
+    size_t iov_len;
+};
+#else
+using IoVec = ::iovec;
+#endif
+
+/**
+ * @brief Packed records as a list of buffers for writev()/sendmsg()
+ *
+ * Numeric fields, padding and short strings are packed into a header
+ * buffer owned by the output, string values of at least threshold() bytes
+ * are referenced in place. The bytes described by iov() are identical to
+ * Format::pack, referenced strings must outlive the output.
+ */
+class GatherOutput {
+  public:
+    static constexpr size_t default_threshold = 256;
+
+    explicit GatherOutput(size_t threshold = default_threshold)
+        : m_threshold(threshold) {}
+
+    size_t threshold() const noexcept { return m_threshold; }
+
+    /**
+     * @brief append one record, see pack_gather()
+     * @throw std::invalid_argument if the arguments do not match
+     */
+    void append(const Format &format,
+                const __phpack__detail::php_pack_arg *argv, size_t argc);
+
+    /**
+     * @brief append the CRC32C of everything appended since the last
+     * trailer, or since clear(), as a 4 byte trailer
+     * @param code 'N' or 'V'
+     * @throw std::invalid_argument for other codes
+     */
+    void append_crc32c(char code = 'N');
+
+    /**
+     * @brief iov
+     * @return buffers of every appended record, valid until the next
+     * append() or clear()
+     */
+    const std::vector<IoVec> &iov();
+
+    /**
+     * @brief size
+     * @return total number of bytes
+     */
+    size_t size() const noexcept { return m_size; }
+
+    /**
+     * @brief str
+     * @return a contiguous copy of the bytes
+     */
+    std::string str() const;
+
+    void clear() noexcept;
+
+  private:
+    /* bytes of the header, or of a referenced string if ref is set */
+    struct segment {
+        const char *ref;
+        size_t offset;
+        size_t size;
+    };
+
+    char *header(size_t size);
+    void reference(const char *data, size_t size);
+
+    std::string m_header;
+    std::vector<segment> m_segments;
+    std::vector<IoVec> m_iov;
+    /* where the bytes not covered by a trailer yet start */
+    size_t m_crc_segment = 0;
+    size_t m_crc_skip = 0;
+    size_t m_size = 0;
+    size_t m_threshold;
+};
+
+/**
+ * @brief pack a record into a gather output
+ * @param output
+ * @param format
+ * @param args same as Format::pack
+ */
+template <typename... Args>
+void pack_gather(GatherOutput &output, const Format &format,
+                 const Args &...args) {
+    using namespace __phpack__detail;
+    std::array<php_pack_arg, sizeof...(Args)> argv = {
+        {php_make_pack_arg(args)...}};
+    output.append(format, argv.data(), argv.size());
+}
+
+} // namespace PhPacker
+
+#endif /* GATHER_H */
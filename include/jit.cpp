@@ -0,0 +1,478 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "jit.h"
+#include "bulk.h"
+#include "dispatch.h"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#ifdef PHPACK_JIT
+#include <cpuid.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace PhPacker {
+
+namespace __phpack__detail {
+
+namespace {
+
+template <char Code> void php_slot_store(uint64_t slot, char *dst) noexcept {
+    php_store_uint<php_pack_code_size(Code), php_code_is_little(Code)>(slot,
+                                                                       dst);
+}
+
+template <char Code> uint64_t php_slot_load(const char *src) noexcept {
+    constexpr size_t size = php_pack_code_size(Code);
+    const uint64_t v = php_load_uint<size, php_code_is_little(Code)>(src);
+    if constexpr (php_code_is_signed(Code) && size < 8) {
+        constexpr unsigned shift = 64 - 8 * size;
+        return static_cast<uint64_t>(static_cast<int64_t>(v << shift) >>
+                                     shift);
+    } else {
+        return v;
+    }
+}
+
+/* the slot of a pack() argument */
+uint64_t php_arg_slot(char code, const php_pack_arg &arg) noexcept {
+    if (code == 'f' || code == 'g' || code == 'G') {
+        const float f = static_cast<float>(php_arg_to_double(arg));
+        uint32_t bits{};
+        memcpy(&bits, &f, sizeof(float));
+        return bits;
+    }
+    if (code == 'd' || code == 'e' || code == 'E') {
+        const double d = php_arg_to_double(arg);
+        uint64_t bits{};
+        memcpy(&bits, &d, sizeof(double));
+        return bits;
+    }
+    return php_arg_to_uint(arg);
+}
+
+/* a slot typed like Format::unpack */
+std::any php_slot_any(char code, uint64_t v) {
+    switch (code) {
+    case 'f':
+    case 'g':
+    case 'G': {
+        const auto bits = static_cast<uint32_t>(v);
+        float f{};
+        memcpy(&f, &bits, sizeof(float));
+        return f;
+    }
+    case 'd':
+    case 'e':
+    case 'E': {
+        double d{};
+        memcpy(&d, &v, sizeof(double));
+        return d;
+    }
+    case 'c':
+        return static_cast<signed char>(v);
+    case 'C':
+        return static_cast<unsigned char>(v);
+    case 's':
+        return static_cast<short>(v);
+    case 'S':
+    case 'n':
+    case 'v':
+        return static_cast<unsigned short>(v);
+    case 'i':
+        return static_cast<int>(v);
+    case 'I':
+        return static_cast<unsigned int>(v);
+    case 'l':
+        return static_cast<int32_t>(v);
+    case 'L':
+    case 'N':
+    case 'V':
+        return static_cast<uint32_t>(v);
+    case 'q':
+        return static_cast<int64_t>(v);
+    }
+    return v;
+}
+
+#ifdef PHPACK_JIT
+
+/* x86-64 machine code for the fields of a format. Encoders read slots
+ * at rdi and write the record at rsi, decoders the other way around. */
+class php_jit_emitter {
+  public:
+    explicit php_jit_emitter(bool movbe) : m_movbe(movbe) {}
+
+    std::vector<unsigned char> &code() noexcept { return m_code; }
+
+    /* mov rax, [rdi + disp], then store the low size bytes to [rsi + off] */
+    void encode_field(const FormatField &field, int32_t slot, int32_t off) {
+        const bool swap = !php_code_is_little(field.code);
+        op({0x48, 0x8b}, rax, rdi, slot);
+        switch (field.size) {
+        case 1:
+            op({0x88}, rax, rsi, off);
+            break;
+        case 2:
+            if (swap && m_movbe) {
+                op({0x66, 0x0f, 0x38, 0xf1}, rax, rsi, off);
+                break;
+            }
+            if (swap) {
+                emit({0x66, 0xc1, 0xc0, 0x08}); // rol ax, 8
+            }
+            op({0x66, 0x89}, rax, rsi, off);
+            break;
+        case 4:
+            if (swap && m_movbe) {
+                op({0x0f, 0x38, 0xf1}, rax, rsi, off);
+                break;
+            }
+            if (swap) {
+                emit({0x0f, 0xc8}); // bswap eax
+            }
+            op({0x89}, rax, rsi, off);
+            break;
+        default:
+            if (swap && m_movbe) {
+                op({0x48, 0x0f, 0x38, 0xf1}, rax, rsi, off);
+                break;
+            }
+            if (swap) {
+                emit({0x48, 0x0f, 0xc8}); // bswap rax
+            }
+            op({0x48, 0x89}, rax, rsi, off);
+            break;
+        }
+    }
+
+    /* mov byte [rsi + off], 0 for each padding byte */
+    void zero(size_t offset, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            op({0xc6}, 0, rsi, static_cast<int32_t>(offset + i));
+            emit({0x00});
+        }
+    }
+
+    /* load size bytes from [rdi + off] into rax, extended to 64 bits,
+     * then mov [rsi + slot], rax */
+    void decode_field(const FormatField &field, int32_t off, int32_t slot) {
+        const bool swap = !php_code_is_little(field.code);
+        const bool is_signed = php_code_is_signed(field.code);
+        switch (field.size) {
+        case 1:
+            if (is_signed) {
+                op({0x48, 0x0f, 0xbe}, rax, rdi, off); // movsx rax, byte
+            } else {
+                op({0x0f, 0xb6}, rax, rdi, off); // movzx eax, byte
+            }
+            break;
+        case 2:
+            if (!swap) {
+                if (is_signed) {
+                    op({0x48, 0x0f, 0xbf}, rax, rdi, off); // movsx rax, word
+                } else {
+                    op({0x0f, 0xb7}, rax, rdi, off); // movzx eax, word
+                }
+                break;
+            }
+            if (m_movbe) {
+                op({0x66, 0x0f, 0x38, 0xf0}, rax, rdi, off);
+            } else {
+                op({0x0f, 0xb7}, rax, rdi, off);
+                emit({0x66, 0xc1, 0xc0, 0x08}); // rol ax, 8
+            }
+            if (is_signed) {
+                emit({0x48, 0x0f, 0xbf, 0xc0}); // movsx rax, ax
+            } else {
+                emit({0x0f, 0xb7, 0xc0}); // movzx eax, ax
+            }
+            break;
+        case 4:
+            if (!swap) {
+                if (is_signed) {
+                    op({0x48, 0x63}, rax, rdi, off); // movsxd rax, dword
+                } else {
+                    op({0x8b}, rax, rdi, off);
+                }
+                break;
+            }
+            if (m_movbe) {
+                op({0x0f, 0x38, 0xf0}, rax, rdi, off);
+            } else {
+                op({0x8b}, rax, rdi, off);
+                emit({0x0f, 0xc8}); // bswap eax
+            }
+            if (is_signed) {
+                emit({0x48, 0x63, 0xc0}); // movsxd rax, eax
+            }
+            break;
+        default:
+            if (swap && m_movbe) {
+                op({0x48, 0x0f, 0x38, 0xf0}, rax, rdi, off);
+                break;
+            }
+            op({0x48, 0x8b}, rax, rdi, off);
+            if (swap) {
+                emit({0x48, 0x0f, 0xc8}); // bswap rax
+            }
+            break;
+        }
+        op({0x48, 0x89}, rax, rsi, slot);
+    }
+
+    void ret() { emit({0xc3}); }
+
+  private:
+    static constexpr unsigned rax = 0;
+    static constexpr unsigned rsi = 6;
+    static constexpr unsigned rdi = 7;
+
+    void emit(std::initializer_list<unsigned> bytes) {
+        for (unsigned b : bytes) {
+            m_code.push_back(static_cast<unsigned char>(b));
+        }
+    }
+
+    /* opcode bytes, then ModRM for reg and [base + disp]. rsi and rdi
+     * as base need neither a SIB byte nor a REX extension */
+    void op(std::initializer_list<unsigned> opcode, unsigned reg,
+            unsigned base, int32_t disp) {
+        emit(opcode);
+        if (disp == 0) {
+            emit({reg << 3 | base});
+        } else if (disp >= -128 && disp <= 127) {
+            emit({0x40 | reg << 3 | base, static_cast<unsigned>(disp) & 0xff});
+        } else {
+            emit({0x80 | reg << 3 | base});
+            const auto u = static_cast<uint32_t>(disp);
+            emit({u & 0xff, (u >> 8) & 0xff, (u >> 16) & 0xff, u >> 24});
+        }
+    }
+
+    bool m_movbe;
+    std::vector<unsigned char> m_code;
+};
+
+#endif
+
+} // namespace
+
+#ifdef PHPACK_JIT
+
+std::unique_ptr<php_jit_code> php_jit_code::compile(const Format &format,
+                                                    bool movbe) {
+    constexpr size_t max_offset = std::numeric_limits<int32_t>::max() / 8;
+    if (format.size() > max_offset || format.args() > max_offset) {
+        return nullptr;
+    }
+
+    php_jit_emitter encoder(movbe);
+    php_jit_emitter decoder(movbe);
+    int32_t slot = 0;
+    for (const FormatField &field : format.fields()) {
+        const auto offset = static_cast<int32_t>(field.offset);
+        if (!field.takes_value()) {
+            encoder.zero(field.offset, field.size);
+            continue;
+        }
+        encoder.encode_field(field, slot, offset);
+        decoder.decode_field(field, offset, slot);
+        slot += 8;
+    }
+    encoder.ret();
+    decoder.ret();
+
+    const std::vector<unsigned char> &enc = encoder.code();
+    const std::vector<unsigned char> &dec = decoder.code();
+    const auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t size = (enc.size() + dec.size() + page - 1) / page * page;
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return nullptr;
+    }
+    auto *bytes = static_cast<unsigned char *>(memory);
+    memcpy(bytes, enc.data(), enc.size());
+    memcpy(bytes + enc.size(), dec.data(), dec.size());
+    /* never writable and executable at once */
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        return nullptr;
+    }
+
+    std::unique_ptr<php_jit_code> code(new php_jit_code());
+    code->m_memory = memory;
+    code->m_size = size;
+    code->m_encode = reinterpret_cast<encode_fn>(memory);
+    code->m_decode = reinterpret_cast<decode_fn>(bytes + enc.size());
+    return code;
+}
+
+php_jit_code::~php_jit_code() {
+    if (m_memory) {
+        munmap(m_memory, m_size);
+    }
+}
+
+bool php_cpu_movbe() noexcept {
+    unsigned eax = 0;
+    unsigned ebx = 0;
+    unsigned ecx = 0;
+    unsigned edx = 0;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    return (ecx & bit_MOVBE) != 0;
+}
+
+bool php_jit_movbe() noexcept {
+    return php_cpu_movbe() && kernel_isa() != Isa::Scalar;
+}
+
+#else
+
+std::unique_ptr<php_jit_code> php_jit_code::compile(const Format &, bool) {
+    return nullptr;
+}
+
+php_jit_code::~php_jit_code() = default;
+
+bool php_cpu_movbe() noexcept { return false; }
+
+bool php_jit_movbe() noexcept { return false; }
+
+#endif
+
+} // namespace __phpack__detail
+
+JitFormat::JitFormat(const Format &format, bool native) : m_format(format) {
+    using namespace __phpack__detail;
+    if (!format.fixed()) {
+        throw std::invalid_argument("JitFormat: format \"" + format.str() +
+                                    "\" has no fixed size");
+    }
+    for (const FormatField &field : format.fields()) {
+        if (!field.takes_value()) {
+            m_padding.emplace_back(field.offset, field.size);
+            continue;
+        }
+        Field f{field.code, field.offset, nullptr, nullptr};
+        const bool numeric =
+            !field.is_bits() && php_array_dispatch(field.code, [&](auto c) {
+                f.store = &php_slot_store<decltype(c)::value>;
+                f.load = &php_slot_load<decltype(c)::value>;
+            });
+        if (!numeric) {
+            throw std::invalid_argument(php_type_error(
+                field.code, "JitFormat takes numeric fields only"));
+        }
+        m_fields.push_back(f);
+    }
+    if (native) {
+        m_code = php_jit_code::compile(m_format, php_jit_movbe());
+    }
+    if (m_code) {
+        m_encode = m_code->encode();
+        m_decode = m_code->decode();
+    }
+}
+
+JitFormat::~JitFormat() = default;
+
+void JitFormat::interpret_encode(const uint64_t *slots,
+                                 char *out) const noexcept {
+    for (const auto &pad : m_padding) {
+        memset(out + pad.first, 0, pad.second);
+    }
+    for (const Field &field : m_fields) {
+        field.store(*slots++, out + field.offset);
+    }
+}
+
+void JitFormat::interpret_decode(const char *data,
+                                 uint64_t *slots) const noexcept {
+    for (const Field &field : m_fields) {
+        *slots++ = field.load(data + field.offset);
+    }
+}
+
+void JitFormat::pack_args(const __phpack__detail::php_pack_arg *argv,
+                          size_t argc, char *out) const {
+    using namespace __phpack__detail;
+    m_format.check_args(argv, argc);
+
+    std::array<uint64_t, 32> local;
+    std::vector<uint64_t> heap;
+    uint64_t *slots = local.data();
+    if (m_fields.size() > local.size()) {
+        heap.resize(m_fields.size());
+        slots = heap.data();
+    }
+    const bool saturate = m_format.conversion() == Conversion::Saturate;
+    size_t a = 0;
+    for (const FormatField &field : m_format.fields()) {
+        if (!field.takes_value()) {
+            continue;
+        }
+        const php_pack_arg arg =
+            saturate ? php_saturate_arg(field, argv[a]) : argv[a];
+        slots[a++] = php_arg_slot(field.code, arg);
+    }
+    encode(slots, out);
+}
+
+std::vector<std::any> JitFormat::unpack(std::string_view data) const {
+    using namespace __phpack__detail;
+    if (data.size() < size()) {
+        throw std::out_of_range("JitFormat: not enough input, need " +
+                                std::to_string(size()) + ", have " +
+                                std::to_string(data.size()));
+    }
+    std::array<uint64_t, 32> local;
+    std::vector<uint64_t> heap;
+    uint64_t *slots = local.data();
+    if (m_fields.size() > local.size()) {
+        heap.resize(m_fields.size());
+        slots = heap.data();
+    }
+    decode(data.data(), slots);
+
+    std::vector<std::any> result;
+    result.reserve(m_fields.size());
+    for (size_t i = 0; i < m_fields.size(); ++i) {
+        result.push_back(php_slot_any(m_fields[i].code, slots[i]));
+    }
+    return result;
+}
+
+} // namespace PhPacker
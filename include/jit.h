@@ -0,0 +1,192 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef JIT_H
+#define JIT_H
+
+#include "format.h"
+
+#include <any>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* native code is emitted for the System V x86-64 ABI into mmap()ed
+ * memory, every other target uses the interpreter */
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#define PHPACK_JIT 1
+#endif
+
+namespace PhPacker {
+
+namespace __phpack__detail {
+
+/* executable memory holding the encoder and decoder of a JitFormat */
+class php_jit_code {
+  public:
+    using encode_fn = void (*)(const uint64_t *slots, char *out);
+    using decode_fn = void (*)(const char *data, uint64_t *slots);
+
+    /* nullptr if the memory could not be mapped */
+    static std::unique_ptr<php_jit_code> compile(const Format &format,
+                                                 bool movbe);
+
+    ~php_jit_code();
+    php_jit_code(const php_jit_code &) = delete;
+    php_jit_code &operator=(const php_jit_code &) = delete;
+
+    encode_fn encode() const noexcept { return m_encode; }
+    decode_fn decode() const noexcept { return m_decode; }
+    size_t size() const noexcept { return m_size; }
+
+  private:
+    php_jit_code() = default;
+
+    void *m_memory = nullptr;
+    size_t m_size = 0;
+    encode_fn m_encode = nullptr;
+    decode_fn m_decode = nullptr;
+};
+
+/* true if the CPU has movbe */
+bool php_cpu_movbe() noexcept;
+
+/* true if php_cpu_movbe() and kernel_isa() is not Scalar */
+bool php_jit_movbe() noexcept;
+
+} // namespace __phpack__detail
+
+/**
+ * @brief A Format compiled to native encode and decode functions
+ *
+ * Each value travels as a 64 bit slot: integers as their two's
+ * complement bits, sign extended on decode for c, s, i, l and q, and
+ * floats as the bits of a float (f, g, G) or double (d, e, E). On x86-64
+ * the format becomes straight-line code, one load and one store per
+ * field at precomputed offsets, byte swapped with movbe when the CPU has
+ * it and bswap otherwise. Elsewhere, or with native set to false, the
+ * same slots go through a loop over the fields.
+ *
+ * pack() and unpack() take and return the same values as Format.
+ */
+class JitFormat {
+  public:
+    /**
+     * @param format a fixed format of numeric codes and x padding
+     * @param native false to always use the interpreter
+     * @throw std::invalid_argument for string, bit or '*' fields
+     */
+    explicit JitFormat(const Format &format, bool native = true);
+    ~JitFormat();
+
+    JitFormat(const JitFormat &) = delete;
+    JitFormat &operator=(const JitFormat &) = delete;
+
+    /**
+     * @brief true if encode() and decode() run compiled code
+     */
+    bool native() const noexcept { return m_code != nullptr; }
+
+    const Format &format() const noexcept { return m_format; }
+    size_t size() const noexcept { return m_format.size(); }
+
+    /**
+     * @brief number of slots, one per field that takes a value
+     */
+    size_t slots() const noexcept { return m_fields.size(); }
+
+    /**
+     * @brief pack slots() values into size() bytes at out
+     */
+    void encode(const uint64_t *slots, char *out) const noexcept {
+        if (m_encode) {
+            m_encode(slots, out);
+        } else {
+            interpret_encode(slots, out);
+        }
+    }
+
+    /**
+     * @brief unpack size() bytes at data into slots() values
+     */
+    void decode(const char *data, uint64_t *slots) const noexcept {
+        if (m_decode) {
+            m_decode(data, slots);
+        } else {
+            interpret_decode(data, slots);
+        }
+    }
+
+    /**
+     * @brief pack like Format::pack, honoring its Conversion
+     * @throw std::invalid_argument if the arguments do not match
+     * @throw RangeError as Format::pack
+     */
+    template <typename... Args> std::string pack(const Args &...args) const {
+        using namespace __phpack__detail;
+        std::array<php_pack_arg, sizeof...(Args)> argv = {
+            {php_make_pack_arg(args)...}};
+        std::string output(size(), '\0');
+        pack_args(argv.data(), argv.size(), &output[0]);
+        return output;
+    }
+
+    /**
+     * @brief unpack like Format::unpack
+     * @throw std::out_of_range if data is shorter than size()
+     */
+    std::vector<std::any> unpack(std::string_view data) const;
+
+  private:
+    struct Field {
+        char code;
+        size_t offset;
+        void (*store)(uint64_t slot, char *dst) noexcept;
+        uint64_t (*load)(const char *src) noexcept;
+    };
+
+    void pack_args(const __phpack__detail::php_pack_arg *argv, size_t argc,
+                   char *out) const;
+    void interpret_encode(const uint64_t *slots, char *out) const noexcept;
+    void interpret_decode(const char *data, uint64_t *slots) const noexcept;
+
+    Format m_format;
+    std::vector<Field> m_fields;
+    /* x padding, zeroed by the interpreter */
+    std::vector<std::pair<size_t, size_t>> m_padding;
+    std::unique_ptr<__phpack__detail::php_jit_code> m_code;
+    __phpack__detail::php_jit_code::encode_fn m_encode = nullptr;
+    __phpack__detail::php_jit_code::decode_fn m_decode = nullptr;
+};
+
+} // namespace PhPacker
+
+#endif /* JIT_H */
@@ -44,6 +44,17 @@ void php_pack_impl(const char* v, size_t size, int* map, std::string& output) no
     }
 }
 
+uint64_t php_double_to_uint(double d) noexcept
+{
+    if (d >= 0.0 && d < 18446744073709551616.0) {
+        return static_cast<uint64_t>(d);
+    }
+    if (d < 0.0 && d >= -9223372036854775808.0) {
+        return static_cast<uint64_t>(static_cast<int64_t>(d));
+    }
+    return 0;
+}
+
 inline double ToDouble(int value)
 {
     return static_cast<double>(value);
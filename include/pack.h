@@ -34,7 +34,9 @@
 #include <cstdint>
 #include <cstring>
 #include <limits>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
 
 namespace PhPacker {
 
@@ -72,6 +74,15 @@ void php_pack_machine_dependent_copy_double(double val,
 #define SIZEOF_LONG 4
 #endif
 
+/* static_cast that doesn't trip -Wuseless-cast when the types match */
+template <typename To, typename From> constexpr To php_narrow(From v) noexcept {
+    if constexpr (std::is_same_v<To, From>) {
+        return v;
+    } else {
+        return static_cast<To>(v);
+    }
+}
+
 constexpr bool is_little_endian() {
 #ifdef _WIN32
     return true;
@@ -184,8 +195,127 @@ constexpr std::array<int, 8> longlongMapBE() {
     }
 }
 
+/* store the low Size bytes of v in little or big endian byte order */
+template <size_t Size, bool Little>
+inline void php_store_uint(uint64_t v, char *dst) noexcept {
+    for (size_t i = 0; i < Size; ++i) {
+        dst[Little ? i : Size - 1 - i] =
+            static_cast<char>(static_cast<unsigned char>(v >> (8 * i)));
+    }
+}
+
+/* load Size bytes stored in little or big endian byte order */
+template <size_t Size, bool Little>
+inline uint64_t php_load_uint(const char *src) noexcept {
+    uint64_t v = 0;
+    for (size_t i = 0; i < Size; ++i) {
+        v |= static_cast<uint64_t>(
+                 static_cast<unsigned char>(src[Little ? i : Size - 1 - i]))
+             << (8 * i);
+    }
+    return v;
+}
+
+/* number of bytes packed by a numeric code, 0 for anything else */
+constexpr size_t php_pack_code_size(char code) noexcept {
+    switch (code) {
+    case 'c':
+    case 'C':
+        return 1;
+    case 's':
+    case 'S':
+    case 'n':
+    case 'v':
+        return 2;
+    case 'i':
+    case 'I':
+        return sizeof(int);
+    case 'l':
+    case 'L':
+    case 'N':
+    case 'V':
+        return 4;
+#if SIZEOF_LONG > 4
+    case 'q':
+    case 'Q':
+    case 'J':
+    case 'P':
+        return 8;
+#endif
+    case 'f':
+    case 'g':
+    case 'G':
+        return sizeof(float);
+    case 'd':
+    case 'e':
+    case 'E':
+        return sizeof(double);
+    }
+    return 0;
+}
+
+/* byte order of a numeric code, machine order for s, i, l, q etc. */
+constexpr bool php_code_is_little(char code) noexcept {
+    switch (code) {
+    case 'v':
+    case 'V':
+    case 'P':
+    case 'g':
+    case 'e':
+        return true;
+    case 'n':
+    case 'N':
+    case 'J':
+    case 'G':
+    case 'E':
+        return false;
+    }
+    return is_little_endian();
+}
+
+/* out of range doubles convert to 0, like php does for non finite values */
+uint64_t php_double_to_uint(double d) noexcept;
+
+constexpr bool php_pack_code_is_float(char code) noexcept {
+    return code == 'f' || code == 'g' || code == 'G' || code == 'd' ||
+           code == 'e' || code == 'E';
+}
+
+constexpr bool php_code_is_signed(char code) noexcept {
+    return code == 'c' || code == 's' || code == 'i' || code == 'l' ||
+           code == 'q';
+}
+
 } // namespace __phpack__detail
 
+/**
+ * @brief What packing does with a value that does not fit its code
+ *
+ * Wrap keeps the low bytes like php does, Check throws a RangeError and
+ * Saturate clamps to the nearest value the code can hold. NaN saturates
+ * to 0 for integer codes.
+ */
+enum class Conversion { Wrap, Check, Saturate };
+
+/**
+ * @brief Thrown by Conversion::Check, index() is the first value that
+ * does not fit
+ */
+class RangeError : public std::out_of_range {
+  public:
+    RangeError(char code, size_t index)
+        : std::out_of_range(std::string("Type ") + code + ": value " +
+                            std::to_string(index) + " out of range"),
+          m_code(code), m_index(index) {}
+
+    char code() const noexcept { return m_code; }
+    size_t index() const noexcept { return m_index; }
+
+  private:
+    char m_code;
+    size_t m_index;
+};
+
 /**
  * @brief pack
  * @param code
@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "pack_ring.h"
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace PhPacker {
+
+PackRing::PackRing(size_t slots, size_t slot_size) : m_slot_size(slot_size) {
+    /* with one slot, a committed slot's pos + 1 would equal its free
+     * sequence number for the next lap */
+    size_t n = 2;
+    while (n < slots) {
+        n *= 2;
+    }
+    m_mask = n - 1;
+    m_slots.reset(new Slot[n]);
+    m_data.reset(new char[n * slot_size]);
+    for (size_t i = 0; i < n; ++i) {
+        m_slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+}
+
+PackRing::Reservation PackRing::try_reserve() noexcept {
+    uint64_t pos = m_tail.load(std::memory_order_relaxed);
+    for (;;) {
+        const Slot &slot = m_slots[pos & m_mask];
+        const uint64_t seq = slot.seq.load(std::memory_order_acquire);
+        if (seq == pos) {
+            if (m_tail.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+                return {data(pos), m_slot_size, pos};
+            }
+        } else if (seq < pos) {
+            /* the consumer has not freed this slot yet */
+            return {};
+        } else {
+            pos = m_tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+PackRing::Reservation PackRing::reserve() noexcept {
+    for (;;) {
+        Reservation r = try_reserve();
+        if (r) {
+            return r;
+        }
+        std::this_thread::yield();
+    }
+}
+
+void PackRing::commit(const Reservation &r, size_t size) noexcept {
+    Slot &slot = m_slots[r.pos & m_mask];
+    slot.size = size;
+    slot.seq.store(r.pos + 1, std::memory_order_release);
+}
+
+void PackRing::check_size(size_t size) const {
+    if (size > m_slot_size) {
+        throw std::length_error("PackRing: a record of " +
+                                std::to_string(size) +
+                                " bytes does not fit a slot of " +
+                                std::to_string(m_slot_size));
+    }
+}
+
+void PackRing::release(size_t n) noexcept {
+    for (size_t i = 0; i < n; ++i, ++m_head) {
+        m_slots[m_head & m_mask].seq.store(m_head + m_mask + 1,
+                                           std::memory_order_release);
+    }
+}
+
+} // namespace PhPacker
@@ -0,0 +1,257 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef PACK_RING_H
+#define PACK_RING_H
+
+#include "format.h"
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string_view>
+
+namespace PhPacker {
+
+/**
+ * @brief Lock free ring of packed records, many producers and one consumer
+ *
+ * The ring has a power of two number of slots of slot_size() bytes each.
+ * A producer claims the next free slot with one CAS, packs straight into
+ * it and commits it. The consumer hands out committed slots in ring order,
+ * one record or one contiguous run of slots at a time, and frees a whole
+ * batch at once, so a record never has to be copied into a string or moved
+ * under a lock.
+ *
+ * Every reservation must be committed, a record committed with size 0 is
+ * skipped by drain().
+ */
+class PackRing {
+  public:
+    static constexpr size_t default_slot_size = 256;
+
+    /**
+     * @brief A claimed slot, valid until it is committed
+     */
+    struct Reservation {
+        char *data = nullptr;
+        size_t capacity = 0;
+        uint64_t pos = 0;
+
+        explicit operator bool() const noexcept { return data != nullptr; }
+    };
+
+    /**
+     * @param slots rounded up to a power of two, at least 2
+     * @param slot_size the largest record
+     */
+    explicit PackRing(size_t slots, size_t slot_size = default_slot_size);
+
+    PackRing(const PackRing &) = delete;
+    PackRing &operator=(const PackRing &) = delete;
+
+    size_t slots() const noexcept { return m_mask + 1; }
+    size_t slot_size() const noexcept { return m_slot_size; }
+
+    /**
+     * @brief claim a slot, thread safe
+     * @return an empty reservation if the ring is full
+     */
+    Reservation try_reserve() noexcept;
+
+    /**
+     * @brief claim a slot, yielding while the ring is full
+     */
+    Reservation reserve() noexcept;
+
+    /**
+     * @brief publish size bytes of a reserved slot to the consumer
+     */
+    void commit(const Reservation &r, size_t size) noexcept;
+
+    /**
+     * @brief pack a record into the next slot
+     * @return false if the ring is full
+     * @throw std::invalid_argument if the arguments do not match format
+     * @throw std::length_error if the record is larger than slot_size()
+     */
+    template <typename... Args>
+    bool try_pack(const Format &format, const Args &...args) {
+        check_size(format.packed_size(args...));
+        Reservation r = try_reserve();
+        if (!r) {
+            return false;
+        }
+        commit(r, format.pack_to(r.data, r.capacity, args...));
+        return true;
+    }
+
+    /**
+     * @brief like try_pack, but waits for a free slot
+     */
+    template <typename... Args>
+    void pack(const Format &format, const Args &...args) {
+        check_size(format.packed_size(args...));
+        Reservation r = reserve();
+        commit(r, format.pack_to(r.data, r.capacity, args...));
+    }
+
+    /**
+     * @brief consumer side, call f(std::string_view) for every record that
+     * is committed in order from the last drain, then free their slots.
+     * Must only be called by one thread at a time.
+     * @param f
+     * @param max stop after this many slots
+     * @return number of slots drained
+     */
+    template <typename F>
+    size_t drain(F &&f, size_t max = std::numeric_limits<size_t>::max()) {
+        size_t n = 0;
+        try {
+            for (; n < max; ++n) {
+                const uint64_t pos = m_head + n;
+                const Slot &slot = m_slots[pos & m_mask];
+                if (slot.seq.load(std::memory_order_acquire) != pos + 1) {
+                    break;
+                }
+                if (slot.size) {
+                    f(std::string_view(data(pos), slot.size));
+                }
+            }
+        } catch (...) {
+            release(n);
+            throw;
+        }
+        release(n);
+        return n;
+    }
+
+  private:
+    struct Slot;
+
+  public:
+    /**
+     * @brief Committed slots that are adjacent in memory
+     *
+     * Record i starts at data() + i * slot_size(). When every record fills
+     * its slot, e.g. with a slot_size() of a fixed Format::size(), bytes()
+     * is the records back to back and can be written with one call.
+     */
+    class Run {
+      public:
+        /* number of slots */
+        size_t size() const noexcept { return m_count; }
+        const char *data() const noexcept { return m_data; }
+        /* every slot of the run, including the unused tail of each */
+        std::string_view bytes() const noexcept {
+            return std::string_view(m_data, m_count * m_stride);
+        }
+        /* empty for a record committed with size 0 */
+        std::string_view operator[](size_t i) const noexcept;
+
+      private:
+        friend class PackRing;
+        Run(const char *data, size_t count, size_t stride,
+            const Slot *slots) noexcept
+            : m_data(data), m_count(count), m_stride(stride), m_slots(slots) {}
+
+        const char *m_data;
+        size_t m_count;
+        size_t m_stride;
+        const Slot *m_slots;
+    };
+
+    /**
+     * @brief consumer side, call f(const Run &) for every run of slots that
+     * is committed in order from the last drain, then free them. A run
+     * ends where the ring wraps or at the first slot not yet committed.
+     * Must only be called by one thread at a time.
+     * @param f
+     * @param max stop after this many slots
+     * @return number of slots drained
+     */
+    template <typename F>
+    size_t drain_runs(F &&f, size_t max = std::numeric_limits<size_t>::max()) {
+        size_t n = 0;
+        try {
+            while (n < max) {
+                const uint64_t start = m_head + n;
+                size_t count = 0;
+                do {
+                    const uint64_t pos = start + count;
+                    if (m_slots[pos & m_mask].seq.load(
+                            std::memory_order_acquire) != pos + 1) {
+                        break;
+                    }
+                    ++count;
+                } while (n + count < max && ((start + count) & m_mask) != 0);
+                if (count == 0) {
+                    break;
+                }
+                f(Run(data(start), count, m_slot_size,
+                      &m_slots[start & m_mask]));
+                n += count;
+            }
+        } catch (...) {
+            release(n);
+            throw;
+        }
+        release(n);
+        return n;
+    }
+
+  private:
+    struct alignas(64) Slot {
+        /* pos when free, pos + 1 when committed */
+        std::atomic<uint64_t> seq{0};
+        size_t size = 0;
+    };
+
+    char *data(uint64_t pos) const noexcept {
+        return m_data.get() + (pos & m_mask) * m_slot_size;
+    }
+    void check_size(size_t size) const;
+    void release(size_t n) noexcept;
+
+    size_t m_mask;
+    size_t m_slot_size;
+    std::unique_ptr<Slot[]> m_slots;
+    std::unique_ptr<char[]> m_data;
+    alignas(64) std::atomic<uint64_t> m_tail{0};
+    /* only touched by the consumer */
+    alignas(64) uint64_t m_head = 0;
+};
+
+inline std::string_view PackRing::Run::operator[](size_t i) const noexcept {
+    return std::string_view(m_data + i * m_stride, m_slots[i].size);
+}
+
+} // namespace PhPacker
+
+#endif /* PACK_RING_H */
@@ -0,0 +1,224 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "record_index.h"
+#include "bulk.h"
+#include "delta.h"
+#include "format.h"
+
+#include <algorithm>
+#include <any>
+#include <stdexcept>
+
+namespace PhPacker {
+
+namespace {
+
+/* magic, every, records, file size, prefix code, samples */
+const char index_header[] = "a4PPPCP";
+const char index_magic[] = "PXI1";
+
+size_t prefixed_size(char code, std::string_view data) {
+    const size_t prefix = __phpack__detail::php_pack_code_size(code);
+    if (data.size() < prefix) {
+        return 0;
+    }
+    uint64_t length = 0;
+    unpack_array(code, data.data(), 1, &length);
+    if (length > data.size() - prefix) {
+        return 0;
+    }
+    return prefix + length;
+}
+
+void check_prefix_code(char code) {
+    if (__phpack__detail::php_pack_code_size(code) == 0 ||
+        __phpack__detail::php_pack_code_is_float(code)) {
+        throw std::invalid_argument(std::string("Type ") + code +
+                                    ": not an integer code");
+    }
+}
+
+} // namespace
+
+size_t RecordIndex::record_size(std::string_view data,
+                                const size_fn &fn) const {
+    if (m_prefix_code) {
+        return prefixed_size(m_prefix_code, data);
+    }
+    if (!fn) {
+        throw std::invalid_argument(
+            "RecordIndex: a size function is required for this index");
+    }
+    return fn(data);
+}
+
+RecordIndex RecordIndex::build(std::string_view data, char prefix_code,
+                               size_t every) {
+    check_prefix_code(prefix_code);
+    RecordIndex index = build(
+        data,
+        [prefix_code](std::string_view rest) {
+            return prefixed_size(prefix_code, rest);
+        },
+        every);
+    index.m_prefix_code = prefix_code;
+    return index;
+}
+
+RecordIndex RecordIndex::build(std::string_view data,
+                               const size_fn &record_size, size_t every) {
+    RecordIndex index;
+    index.m_every = std::max<size_t>(every, 1);
+    index.m_file_size = data.size();
+
+    size_t pos = 0;
+    while (pos < data.size()) {
+        const size_t size = record_size(data.substr(pos));
+        if (size == 0 || size > data.size() - pos) {
+            throw std::out_of_range("RecordIndex: record " +
+                                    std::to_string(index.m_records) +
+                                    " at offset " + std::to_string(pos) +
+                                    " is truncated");
+        }
+        if (index.m_records % index.m_every == 0) {
+            index.m_samples.push_back(pos);
+        }
+        ++index.m_records;
+        pos += size;
+    }
+    return index;
+}
+
+std::string RecordIndex::serialize() const {
+    std::string output =
+        pack(index_header, std::string_view(index_magic, 4), m_every,
+             m_records, m_file_size, m_prefix_code, m_samples.size());
+    output += pack_delta(reinterpret_cast<const int64_t *>(m_samples.data()),
+                         m_samples.size());
+    return output;
+}
+
+RecordIndex RecordIndex::deserialize(std::string_view data) {
+    const Format &header = thread_format_cache().get(index_header);
+    if (data.size() < header.size() ||
+        data.substr(0, 4) != std::string_view(index_magic, 4)) {
+        throw std::invalid_argument("RecordIndex: not an index");
+    }
+
+    const std::vector<std::any> fields = header.unpack(data);
+    RecordIndex index;
+    index.m_every = std::any_cast<uint64_t>(fields[1]);
+    index.m_records = std::any_cast<uint64_t>(fields[2]);
+    index.m_file_size = std::any_cast<uint64_t>(fields[3]);
+    index.m_prefix_code = static_cast<char>(std::any_cast<unsigned char>(fields[4]));
+    const auto samples = std::any_cast<uint64_t>(fields[5]);
+
+    /* one sample per started group of m_every records, each at least one
+     * varint byte */
+    if (index.m_every == 0 ||
+        samples != index.m_records / index.m_every +
+                       (index.m_records % index.m_every != 0) ||
+        samples > data.size() - header.size()) {
+        throw std::invalid_argument("RecordIndex: corrupt index");
+    }
+    if (index.m_prefix_code) {
+        check_prefix_code(index.m_prefix_code);
+    }
+
+    index.m_samples.resize(samples);
+    try {
+        unpack_delta(data.substr(header.size()), samples,
+                     reinterpret_cast<int64_t *>(index.m_samples.data()));
+    } catch (const std::out_of_range &) {
+        throw std::invalid_argument("RecordIndex: corrupt index");
+    }
+    /* records are never empty, so samples start at 0 and strictly
+     * increase inside the file, offset() and split() rely on it */
+    const std::vector<uint64_t> &s = index.m_samples;
+    bool sorted = s.empty() || (s[0] == 0 && s.back() < index.m_file_size);
+    for (size_t i = 1; sorted && i < s.size(); ++i) {
+        sorted = s[i - 1] < s[i];
+    }
+    if (!sorted) {
+        throw std::invalid_argument("RecordIndex: corrupt index");
+    }
+    return index;
+}
+
+size_t RecordIndex::offset(size_t record, std::string_view data,
+                           const size_fn &record_size_fn) const {
+    if (record >= m_records) {
+        throw std::out_of_range("RecordIndex: no record " +
+                                std::to_string(record));
+    }
+
+    size_t pos = m_samples[record / m_every];
+    for (size_t n = record % m_every; n > 0; --n) {
+        const size_t size =
+            pos < data.size() ? record_size(data.substr(pos), record_size_fn)
+                              : 0;
+        if (size == 0) {
+            throw std::out_of_range("RecordIndex: data does not match index");
+        }
+        pos += size;
+    }
+    return pos;
+}
+
+std::vector<RecordIndex::Range> RecordIndex::split(size_t parts) const {
+    std::vector<Range> ranges;
+    if (m_records == 0 || parts == 0) {
+        return ranges;
+    }
+
+    /* first sample of every range */
+    std::vector<size_t> starts = {0};
+    for (size_t k = 1; k < parts; ++k) {
+        const uint64_t target = m_file_size / parts * k;
+        const size_t s = static_cast<size_t>(
+            std::lower_bound(m_samples.begin(), m_samples.end(), target) -
+            m_samples.begin());
+        if (s < m_samples.size() && s > starts.back()) {
+            starts.push_back(s);
+        }
+    }
+
+    for (size_t r = 0; r < starts.size(); ++r) {
+        const size_t first = starts[r] * m_every;
+        const size_t last =
+            r + 1 < starts.size() ? starts[r + 1] * m_every : m_records;
+        const size_t begin = m_samples[starts[r]];
+        const size_t end =
+            r + 1 < starts.size() ? m_samples[starts[r + 1]] : m_file_size;
+        ranges.push_back({first, last - first, begin, end - begin});
+    }
+    return ranges;
+}
+
+} // namespace PhPacker
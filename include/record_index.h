@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef RECORD_INDEX_H
+#define RECORD_INDEX_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace PhPacker {
+
+/**
+ * @brief Sparse offset index of a file of variable length records
+ *
+ * Keeps the offset of every every()-th record, so finding a record walks
+ * at most every() - 1 records from the nearest sample. Records are either
+ * length prefixed, the prefix packed with an integer code and counting the
+ * bytes after it, or measured by a caller supplied function.
+ */
+class RecordIndex {
+  public:
+    /* size of the record at the start of data, 0 if it is truncated */
+    using size_fn = std::function<size_t(std::string_view data)>;
+
+    /**
+     * @brief A part of the file as returned by split()
+     */
+    struct Range {
+        size_t first;
+        size_t records;
+        size_t offset;
+        size_t size;
+    };
+
+    static constexpr size_t default_every = 1024;
+
+    /**
+     * @brief index length prefixed records in one pass
+     * @param data
+     * @param prefix_code integer code of the length prefix, e.g. 'N'
+     * @param every
+     * @throw std::invalid_argument if prefix_code is not an integer code
+     * @throw std::out_of_range if the last record is truncated
+     */
+    static RecordIndex build(std::string_view data, char prefix_code,
+                             size_t every = default_every);
+
+    /**
+     * @brief index records measured by record_size in one pass
+     * @throw std::out_of_range if record_size returns 0
+     */
+    static RecordIndex build(std::string_view data, const size_fn &record_size,
+                             size_t every = default_every);
+
+    /**
+     * @brief the compact sidecar form, sample offsets are delta compressed
+     */
+    std::string serialize() const;
+
+    /**
+     * @brief read an index written by serialize()
+     * @throw std::invalid_argument if data is not an index
+     */
+    static RecordIndex deserialize(std::string_view data);
+
+    size_t records() const noexcept { return m_records; }
+    size_t every() const noexcept { return m_every; }
+    size_t file_size() const noexcept { return m_file_size; }
+    const std::vector<uint64_t> &samples() const noexcept { return m_samples; }
+
+    /**
+     * @brief offset of a record
+     * @param record
+     * @param data the indexed file
+     * @param record_size needed if the index was not built from a prefix
+     * @throw std::out_of_range if record >= records()
+     */
+    size_t offset(size_t record, std::string_view data,
+                  const size_fn &record_size = {}) const;
+
+    /**
+     * @brief split the file into at most parts ranges of about the same
+     * size, every range starts at a sample so no walking is needed
+     */
+    std::vector<Range> split(size_t parts) const;
+
+  private:
+    RecordIndex() = default;
+
+    size_t record_size(std::string_view data, const size_fn &fn) const;
+
+    size_t m_every = default_every;
+    size_t m_records = 0;
+    size_t m_file_size = 0;
+    /* 0 if records are measured by a size_fn */
+    char m_prefix_code = 0;
+    std::vector<uint64_t> m_samples;
+};
+
+} // namespace PhPacker
+
+#endif /* RECORD_INDEX_H */
@@ -0,0 +1,180 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "record_view.h"
+
+#include <algorithm>
+
+namespace PhPacker {
+
+RecordLayout::RecordLayout(const Format &format)
+    : m_size(format.size()), m_fixed(format.fixed()) {
+    for (const FormatField &field : format.fields()) {
+        if (!field.takes_value()) {
+            continue;
+        }
+        m_fields.push_back(field);
+        m_names.push_back(std::to_string(m_fields.size()));
+        /* a '*' field takes the rest of the record */
+        if (field.star) {
+            break;
+        }
+    }
+    sort_names();
+}
+
+RecordLayout::RecordLayout(const UnpackFormat &format)
+    : m_fields(format.keys().size()), m_names(format.keys()) {
+    using namespace __phpack__detail;
+
+    size_t pos = 0;
+    for (size_t ei = 0; ei < format.m_elements.size(); ++ei) {
+        const UnpackFormat::element &e = format.m_elements[ei];
+        const bool last = ei + 1 == format.m_elements.size();
+        if (e.star && !(last && e.slots.size() == 1)) {
+            throw std::invalid_argument(php_type_error(
+                e.code, "'*' only works on a final string in a layout"));
+        }
+
+        switch (e.code) {
+        case 'x':
+            pos += e.count;
+            break;
+        case 'X':
+            if (e.count > pos) {
+                throw std::invalid_argument(
+                    php_type_error(e.code, "outside of string"));
+            }
+            pos -= e.count;
+            break;
+        case '@':
+            pos = e.count;
+            break;
+        case 'a':
+        case 'A':
+        case 'Z':
+        case 'h':
+        case 'H': {
+            size_t size = e.count;
+            if (e.star) {
+                size = 0;
+                m_fixed = false;
+            } else if (e.code == 'h' || e.code == 'H') {
+                size = (e.count + 1) / 2;
+            }
+            m_fields[e.slots[0]] = {e.code, pos,    size, e.count,
+                                    e.star, nullptr, nullptr, 0, 0};
+            pos += size;
+            break;
+        }
+        default: {
+            const size_t size = php_pack_code_size(e.code);
+            for (size_t slot : e.slots) {
+                m_fields[slot] = {e.code, pos,    size, 1,
+                                  false,  nullptr, e.load, 0, 0};
+                pos += size;
+            }
+            break;
+        }
+        }
+        m_size = std::max(m_size, pos);
+    }
+    sort_names();
+}
+
+void RecordLayout::sort_names() {
+    m_sorted.resize(m_names.size());
+    for (size_t k = 0; k < m_sorted.size(); ++k) {
+        m_sorted[k] = k;
+    }
+    std::sort(m_sorted.begin(), m_sorted.end(),
+              [this](size_t a, size_t b) { return m_names[a] < m_names[b]; });
+}
+
+size_t RecordLayout::index(std::string_view name) const noexcept {
+    auto it = std::lower_bound(
+        m_sorted.begin(), m_sorted.end(), name,
+        [this](size_t k, std::string_view v) { return m_names[k] < v; });
+    if (it != m_sorted.end() && m_names[*it] == name) {
+        return *it;
+    }
+    return npos;
+}
+
+std::string_view RecordView::bytes(size_t i) const {
+    if (i >= size()) {
+        throw std::out_of_range("RecordView: no field " + std::to_string(i));
+    }
+    const FormatField &field = m_layout->fields()[i];
+    size_t size = field.size;
+    if (field.star) {
+        size = field.offset < m_data.size() ? m_data.size() - field.offset : 0;
+    }
+    if (field.offset + size > m_data.size()) {
+        const size_t have =
+            field.offset < m_data.size() ? m_data.size() - field.offset : 0;
+        throw std::out_of_range(__phpack__detail::php_type_error(
+            field.code, "not enough input, need " + std::to_string(size) +
+                            ", have " + std::to_string(have)));
+    }
+    return m_data.substr(field.offset, size);
+}
+
+std::any RecordView::value(size_t i) const {
+    using namespace __phpack__detail;
+
+    const std::string_view b = bytes(i);
+    const FormatField &field = m_layout->fields()[i];
+    if (field.load) {
+        return field.load(b.data());
+    }
+    if (field.is_bits()) {
+        return php_unpack_bits(field, b.data());
+    }
+    return php_unpack_string(field.code, b,
+                             field.star ? b.size() * 2 : field.count);
+}
+
+size_t RecordView::index(std::string_view name) const {
+    const size_t i = m_layout->index(name);
+    if (i == RecordLayout::npos) {
+        throw std::out_of_range("RecordView: no field '" + std::string(name) +
+                                "'");
+    }
+    return i;
+}
+
+RecordRange::RecordRange(const RecordLayout &layout, std::string_view data)
+    : m_layout(&layout), m_data(data) {
+    if (!layout.fixed() || layout.size() == 0) {
+        throw std::invalid_argument(
+            "RecordRange: records must have a fixed, non zero size");
+    }
+}
+
+} // namespace PhPacker
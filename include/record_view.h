@@ -0,0 +1,305 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef RECORD_VIEW_H
+#define RECORD_VIEW_H
+
+#include "bulk.h"
+#include "format.h"
+#include "unpack_format.h"
+
+#include <any>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#if __cplusplus >= 202002L && __has_include(<ranges>)
+#include <ranges>
+#endif
+
+namespace PhPacker {
+
+/**
+ * @brief The value fields of a format with their offsets and names
+ *
+ * Built once per format and shared by any number of RecordView. Fields
+ * are numbered like the values of Format::unpack, names are those of an
+ * UnpackFormat or "1", "2"... like unnamed php unpack() keys.
+ */
+class RecordLayout {
+  public:
+    static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+    explicit RecordLayout(const Format &format);
+
+    /**
+     * @throw std::invalid_argument if a position depends on the data, as
+     * with '*' elements
+     */
+    explicit RecordLayout(const UnpackFormat &format);
+
+    /**
+     * @brief parse a php unpack() format, e.g. "Nid/nflags/a8name"
+     */
+    explicit RecordLayout(std::string_view format)
+        : RecordLayout(UnpackFormat(format)) {}
+
+    const std::vector<FormatField> &fields() const noexcept {
+        return m_fields;
+    }
+    const std::vector<std::string> &names() const noexcept { return m_names; }
+
+    /**
+     * @brief bytes a record needs, not counting a final '*' field
+     */
+    size_t size() const noexcept { return m_size; }
+
+    /**
+     * @brief true if every record has size() bytes
+     */
+    bool fixed() const noexcept { return m_fixed; }
+
+    /**
+     * @brief the field called name, npos if there is none
+     */
+    size_t index(std::string_view name) const noexcept;
+
+  private:
+    void sort_names();
+
+    std::vector<FormatField> m_fields;
+    std::vector<std::string> m_names;
+    /* indices into m_names, sorted by name */
+    std::vector<size_t> m_sorted;
+    size_t m_size = 0;
+    bool m_fixed = true;
+};
+
+/**
+ * @brief A record that is decoded one field at a time, on access
+ *
+ * Holds only the layout and the bytes, so making one costs nothing. Both
+ * must outlive the view.
+ */
+class RecordView {
+  public:
+    RecordView() = default;
+    RecordView(const RecordLayout &layout, std::string_view data) noexcept
+        : m_layout(&layout), m_data(data) {}
+
+    size_t size() const noexcept { return m_layout->fields().size(); }
+    std::string_view data() const noexcept { return m_data; }
+    const RecordLayout &layout() const noexcept { return *m_layout; }
+
+    /**
+     * @brief the bytes of field i
+     * @throw std::out_of_range if there is no such field or data is too
+     * short for it
+     */
+    std::string_view bytes(size_t i) const;
+
+    /**
+     * @brief field i typed like Format::unpack would
+     */
+    std::any value(size_t i) const;
+    std::any operator[](size_t i) const { return value(i); }
+
+    /**
+     * @brief field i as T
+     *
+     * Numeric and bit fields convert to any arithmetic T without an
+     * std::any, std::string gives the php unpack() string and
+     * std::string_view the raw bytes.
+     *
+     * @throw std::out_of_range as bytes()
+     * @throw std::bad_any_cast if the field can't be a T
+     */
+    template <typename T> T get(size_t i) const {
+        const std::string_view b = bytes(i);
+        const FormatField &field = m_layout->fields()[i];
+        if constexpr (std::is_same<T, std::string_view>::value) {
+            return b;
+        } else if constexpr (std::is_arithmetic<T>::value) {
+            if (field.is_bits()) {
+                return static_cast<T>(
+                    __phpack__detail::php_unpack_bits(field, b.data()));
+            }
+            if (!field.load) {
+                throw std::bad_any_cast();
+            }
+            T v{};
+            unpack_array(field.code, b.data(), 1, &v);
+            return v;
+        } else {
+            return std::any_cast<T>(value(i));
+        }
+    }
+
+    /**
+     * @brief the field called name as T
+     * @throw std::out_of_range if there is no such field
+     */
+    template <typename T> T get(std::string_view name) const {
+        return get<T>(index(name));
+    }
+
+  private:
+    size_t index(std::string_view name) const;
+
+    const RecordLayout *m_layout = nullptr;
+    std::string_view m_data;
+};
+
+/**
+ * @brief Random access range of the fixed size records in a buffer
+ *
+ * Dereferencing yields a RecordView, nothing is decoded until a field is
+ * read. A trailing partial record is not part of the range. With C++20 it
+ * is a borrowed std::ranges::view, so filter and transform pipelines only
+ * read the fields they use.
+ */
+class RecordRange {
+  public:
+    class iterator {
+      public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = RecordView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = RecordView;
+
+        iterator() = default;
+        iterator(const RecordLayout *layout, const char *p) noexcept
+            : m_layout(layout), m_p(p) {}
+
+        RecordView operator*() const noexcept {
+            return RecordView(*m_layout,
+                              std::string_view(m_p, m_layout->size()));
+        }
+        RecordView operator[](difference_type n) const noexcept {
+            return *(*this + n);
+        }
+
+        iterator &operator++() noexcept { return *this += 1; }
+        iterator operator++(int) noexcept {
+            iterator it = *this;
+            ++*this;
+            return it;
+        }
+        iterator &operator--() noexcept { return *this -= 1; }
+        iterator operator--(int) noexcept {
+            iterator it = *this;
+            --*this;
+            return it;
+        }
+        iterator &operator+=(difference_type n) noexcept {
+            m_p += n * static_cast<difference_type>(m_layout->size());
+            return *this;
+        }
+        iterator &operator-=(difference_type n) noexcept {
+            return *this += -n;
+        }
+        friend iterator operator+(iterator it, difference_type n) noexcept {
+            return it += n;
+        }
+        friend iterator operator+(difference_type n, iterator it) noexcept {
+            return it += n;
+        }
+        friend iterator operator-(iterator it, difference_type n) noexcept {
+            return it -= n;
+        }
+        friend difference_type operator-(const iterator &a,
+                                         const iterator &b) noexcept {
+            return (a.m_p - b.m_p) /
+                   static_cast<difference_type>(a.m_layout->size());
+        }
+
+        friend bool operator==(const iterator &a, const iterator &b) noexcept {
+            return a.m_p == b.m_p;
+        }
+        friend bool operator!=(const iterator &a, const iterator &b) noexcept {
+            return a.m_p != b.m_p;
+        }
+        friend bool operator<(const iterator &a, const iterator &b) noexcept {
+            return a.m_p < b.m_p;
+        }
+        friend bool operator>(const iterator &a, const iterator &b) noexcept {
+            return a.m_p > b.m_p;
+        }
+        friend bool operator<=(const iterator &a, const iterator &b) noexcept {
+            return a.m_p <= b.m_p;
+        }
+        friend bool operator>=(const iterator &a, const iterator &b) noexcept {
+            return a.m_p >= b.m_p;
+        }
+
+      private:
+        const RecordLayout *m_layout = nullptr;
+        const char *m_p = nullptr;
+    };
+
+    RecordRange() = default;
+
+    /**
+     * @throw std::invalid_argument unless layout is fixed and not empty
+     */
+    RecordRange(const RecordLayout &layout, std::string_view data);
+
+    iterator begin() const noexcept { return {m_layout, m_data.data()}; }
+    iterator end() const noexcept {
+        return {m_layout, m_data.data() + size() * (m_layout ? m_layout->size() : 0)};
+    }
+    size_t size() const noexcept {
+        return m_layout ? m_data.size() / m_layout->size() : 0;
+    }
+    bool empty() const noexcept { return size() == 0; }
+    RecordView operator[](size_t i) const noexcept {
+        return begin()[static_cast<std::ptrdiff_t>(i)];
+    }
+
+  private:
+    const RecordLayout *m_layout = nullptr;
+    std::string_view m_data;
+};
+
+} // namespace PhPacker
+
+#if __cplusplus >= 202002L && defined(__cpp_lib_ranges)
+template <>
+inline constexpr bool std::ranges::enable_borrowed_range<PhPacker::RecordRange> =
+    true;
+template <>
+inline constexpr bool std::ranges::enable_view<PhPacker::RecordRange> = true;
+#endif
+
+#endif /* RECORD_VIEW_H */
@@ -0,0 +1,266 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "sort_key.h"
+#include "bitfield.h"
+
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PHPACK_KEY_SSE2 1
+#endif
+
+namespace PhPacker {
+
+namespace __phpack__detail {
+
+namespace {
+
+uint64_t key_flip(php_key_kind kind, size_t size, uint64_t v) noexcept {
+    const uint64_t sign = uint64_t{1} << (size * 8 - 1);
+    switch (kind) {
+    case php_key_kind::Signed:
+        return v ^ sign;
+    case php_key_kind::Float:
+        return v & sign ? v ^ php_bit_mask(static_cast<unsigned>(size * 8))
+                        : v ^ sign;
+    case php_key_kind::Unsigned:
+        break;
+    }
+    return v;
+}
+
+uint64_t key_unflip(php_key_kind kind, size_t size, uint64_t v) noexcept {
+    const uint64_t sign = uint64_t{1} << (size * 8 - 1);
+    switch (kind) {
+    case php_key_kind::Signed:
+        return v ^ sign;
+    case php_key_kind::Float:
+        return v & sign ? v ^ sign
+                        : v ^ php_bit_mask(static_cast<unsigned>(size * 8));
+    case php_key_kind::Unsigned:
+        break;
+    }
+    return v;
+}
+
+template <typename W>
+void encode_scalar(php_key_kind kind, const W *bits, size_t n,
+                   char *out) noexcept {
+    for (size_t i = 0; i < n; ++i, out += sizeof(W)) {
+        php_store_uint<sizeof(W), false>(key_flip(kind, sizeof(W), bits[i]),
+                                         out);
+    }
+}
+
+template <typename W>
+void decode_scalar(php_key_kind kind, const char *data, size_t n,
+                   W *bits) noexcept {
+    for (size_t i = 0; i < n; ++i, data += sizeof(W)) {
+        bits[i] = static_cast<W>(key_unflip(
+            kind, sizeof(W), php_load_uint<sizeof(W), false>(data)));
+    }
+}
+
+#ifdef PHPACK_KEY_SSE2
+
+template <size_t Size> __m128i bswap(__m128i x) noexcept {
+    if constexpr (Size == 4) {
+        x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+        x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+    } else if constexpr (Size == 8) {
+        x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+        x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+    }
+    return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+template <size_t Size> __m128i sign_bit() noexcept {
+    if constexpr (Size == 2) {
+        return _mm_set1_epi16(static_cast<short>(0x8000));
+    } else if constexpr (Size == 4) {
+        return _mm_set1_epi32(static_cast<int>(0x80000000));
+    } else {
+        return _mm_set1_epi64x(static_cast<long long>(0x8000000000000000));
+    }
+}
+
+/* all ones in the lanes whose sign bit is set */
+template <size_t Size> __m128i sign_mask(__m128i x) noexcept {
+    const __m128i high = _mm_srai_epi32(x, 31);
+    if constexpr (Size == 4) {
+        return high;
+    } else {
+        return _mm_shuffle_epi32(high, _MM_SHUFFLE(3, 3, 1, 1));
+    }
+}
+
+template <size_t Size>
+size_t encode_sse2(php_key_kind kind, const char *bits, size_t n,
+                   char *out) noexcept {
+    const __m128i sign = sign_bit<Size>();
+    size_t i = 0;
+    for (; i + 16 / Size <= n; i += 16 / Size) {
+        __m128i x =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(bits + i * Size));
+        if (kind == php_key_kind::Signed) {
+            x = _mm_xor_si128(x, sign);
+        } else if constexpr (Size > 2) {
+            if (kind == php_key_kind::Float) {
+                x = _mm_xor_si128(x, _mm_or_si128(sign_mask<Size>(x), sign));
+            }
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * Size),
+                         bswap<Size>(x));
+    }
+    return i;
+}
+
+template <size_t Size>
+size_t decode_sse2(php_key_kind kind, const char *data, size_t n,
+                   char *bits) noexcept {
+    const __m128i sign = sign_bit<Size>();
+    const __m128i ones = _mm_set1_epi32(-1);
+    size_t i = 0;
+    for (; i + 16 / Size <= n; i += 16 / Size) {
+        __m128i x = bswap<Size>(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i * Size)));
+        if (kind == php_key_kind::Signed) {
+            x = _mm_xor_si128(x, sign);
+        } else if constexpr (Size > 2) {
+            if (kind == php_key_kind::Float) {
+                const __m128i m = _mm_xor_si128(sign_mask<Size>(x), ones);
+                x = _mm_xor_si128(x, _mm_or_si128(m, sign));
+            }
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(bits + i * Size), x);
+    }
+    return i;
+}
+
+#endif
+
+template <typename W>
+void encode(php_key_kind kind, const void *bits, size_t n,
+            char *out) noexcept {
+    const W *w = static_cast<const W *>(bits);
+    size_t i = 0;
+#ifdef PHPACK_KEY_SSE2
+    if constexpr (sizeof(W) > 1) {
+        i = encode_sse2<sizeof(W)>(kind, static_cast<const char *>(bits), n,
+                                   out);
+    }
+#endif
+    encode_scalar(kind, w + i, n - i, out + i * sizeof(W));
+}
+
+template <typename W>
+void decode(php_key_kind kind, const char *data, size_t n,
+            void *bits) noexcept {
+    W *w = static_cast<W *>(bits);
+    size_t i = 0;
+#ifdef PHPACK_KEY_SSE2
+    if constexpr (sizeof(W) > 1) {
+        i = decode_sse2<sizeof(W)>(kind, data, n, static_cast<char *>(bits));
+    }
+#endif
+    decode_scalar(kind, data + i * sizeof(W), n - i, w + i);
+}
+
+} // namespace
+
+void php_key_encode(php_key_kind kind, size_t size, const void *bits,
+                    size_t n, char *out) noexcept {
+    php_key_width(size, [&](auto w) {
+        encode<decltype(w)>(kind, bits, n, out);
+    });
+}
+
+void php_key_decode(php_key_kind kind, size_t size, const char *data,
+                    size_t n, void *bits) noexcept {
+    php_key_width(size, [&](auto w) {
+        decode<decltype(w)>(kind, data, n, bits);
+    });
+}
+
+} // namespace __phpack__detail
+
+KeyFormat::KeyFormat(std::string_view format) : m_format(format) {
+    const auto &fields = m_format.fields();
+    for (size_t i = 0; i < fields.size(); ++i) {
+        const FormatField &field = fields[i];
+        if (field.code == 'h' || field.code == 'b') {
+            throw std::invalid_argument(std::string("Type ") + field.code +
+                                        ": does not sort bytewise");
+        }
+        if (field.star && i + 1 != fields.size()) {
+            throw std::invalid_argument(std::string("Type ") + field.code +
+                                        ": '*' must be the last field");
+        }
+    }
+}
+
+void KeyFormat::to_key(char *data) const noexcept {
+    using namespace __phpack__detail;
+    for (const FormatField &field : m_format.fields()) {
+        const size_t size = php_pack_code_size(field.code);
+        if (size == 0) {
+            continue;
+        }
+        char *p = data + field.offset;
+        const uint64_t v =
+            php_load_bytes(p, size, php_code_is_little(field.code));
+        php_store_bytes(key_flip(php_key_kind_of(field.code), size, v), size,
+                        false, p);
+    }
+}
+
+void KeyFormat::from_key(char *data) const noexcept {
+    using namespace __phpack__detail;
+    for (const FormatField &field : m_format.fields()) {
+        const size_t size = php_pack_code_size(field.code);
+        if (size == 0) {
+            continue;
+        }
+        char *p = data + field.offset;
+        const uint64_t v = php_load_bytes(p, size, false);
+        php_store_bytes(key_unflip(php_key_kind_of(field.code), size, v), size,
+                        php_code_is_little(field.code), p);
+    }
+}
+
+std::vector<std::any> KeyFormat::unpack(std::string_view key) const {
+    std::string data(key);
+    if (data.size() >= m_format.size()) {
+        from_key(&data[0]);
+    }
+    return m_format.unpack(data);
+}
+
+} // namespace PhPacker
@@ -0,0 +1,248 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef SORT_KEY_H
+#define SORT_KEY_H
+
+#include "format.h"
+
+#include <algorithm>
+#include <any>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace PhPacker {
+
+namespace __phpack__detail {
+
+enum class php_key_kind { Unsigned, Signed, Float };
+
+constexpr php_key_kind php_key_kind_of(char code) noexcept {
+    if (php_pack_code_is_float(code)) {
+        return php_key_kind::Float;
+    }
+    if (php_code_is_signed(code)) {
+        return php_key_kind::Signed;
+    }
+    return php_key_kind::Unsigned;
+}
+
+/* native value bits <-> big endian memcmp ordered bytes, bits holds n
+ * values of size bytes each */
+void php_key_encode(php_key_kind kind, size_t size, const void *bits,
+                    size_t n, char *out) noexcept;
+void php_key_decode(php_key_kind kind, size_t size, const char *data,
+                    size_t n, void *bits) noexcept;
+
+template <typename W, typename T>
+void php_key_encode_array(char code, const T *values, size_t n, char *out) {
+    constexpr size_t block = 256;
+    W bits[block];
+    const php_key_kind kind = php_key_kind_of(code);
+    for (size_t done = 0; done < n; done += block) {
+        const size_t m = std::min(block, n - done);
+        for (size_t i = 0; i < m; ++i) {
+            const T v = values[done + i];
+            if constexpr (std::is_same<W, uint32_t>::value) {
+                if (kind == php_key_kind::Float) {
+                    const auto f = php_narrow<float>(v);
+                    memcpy(&bits[i], &f, sizeof(float));
+                    continue;
+                }
+            } else if constexpr (std::is_same<W, uint64_t>::value) {
+                if (kind == php_key_kind::Float) {
+                    const auto d = php_narrow<double>(v);
+                    memcpy(&bits[i], &d, sizeof(double));
+                    continue;
+                }
+            }
+            if constexpr (std::is_floating_point<T>::value) {
+                bits[i] = static_cast<W>(
+                    php_double_to_uint(php_narrow<double>(v)));
+            } else {
+                bits[i] = php_narrow<W>(v);
+            }
+        }
+        php_key_encode(kind, sizeof(W), bits, m, out + done * sizeof(W));
+    }
+}
+
+template <typename W, typename T>
+void php_key_decode_array(char code, const char *data, size_t n, T *out) {
+    using S = std::make_signed_t<W>;
+    constexpr size_t block = 256;
+    W bits[block];
+    const php_key_kind kind = php_key_kind_of(code);
+    for (size_t done = 0; done < n; done += block) {
+        const size_t m = std::min(block, n - done);
+        php_key_decode(kind, sizeof(W), data + done * sizeof(W), m, bits);
+        for (size_t i = 0; i < m; ++i) {
+            T &v = out[done + i];
+            if constexpr (std::is_same<W, uint32_t>::value) {
+                if (kind == php_key_kind::Float) {
+                    float f{};
+                    memcpy(&f, &bits[i], sizeof(float));
+                    v = php_narrow<T>(f);
+                    continue;
+                }
+            } else if constexpr (std::is_same<W, uint64_t>::value) {
+                if (kind == php_key_kind::Float) {
+                    double d{};
+                    memcpy(&d, &bits[i], sizeof(double));
+                    v = php_narrow<T>(d);
+                    continue;
+                }
+            }
+            if (kind == php_key_kind::Signed) {
+                v = php_narrow<T>(static_cast<S>(bits[i]));
+            } else {
+                v = php_narrow<T>(bits[i]);
+            }
+        }
+    }
+}
+
+template <typename F> void php_key_width(size_t size, F &&f) {
+    switch (size) {
+    case 1:
+        f(uint8_t{});
+        break;
+    case 2:
+        f(uint16_t{});
+        break;
+    case 4:
+        f(uint32_t{});
+        break;
+    default:
+        f(uint64_t{});
+        break;
+    }
+}
+
+} // namespace __phpack__detail
+
+/**
+ * @brief A pack format whose output sorts correctly under memcmp
+ *
+ * Every numeric field is stored big endian whatever its code, signed
+ * integers get their sign bit flipped and floats the IEEE total order
+ * transform: positive values get the sign bit flipped, negative ones all
+ * bits. So comparing two keys with memcmp, or std::string::compare,
+ * orders them like comparing their fields one after the other. Fixed
+ * width strings ('a', 'A', 'Z', 'H') and 'B' bit fields already sort
+ * bytewise and are stored as is. Only the last field may be a '*' string.
+ */
+class KeyFormat {
+  public:
+    /**
+     * @throw std::invalid_argument if the format is invalid or has a field
+     * that does not sort bytewise ('h', 'b') or a '*' string before the end
+     */
+    explicit KeyFormat(std::string_view format);
+
+    const Format &format() const noexcept { return m_format; }
+    size_t size() const noexcept { return m_format.size(); }
+
+    template <typename... Args> std::string pack(Args &&... args) const {
+        std::string key = m_format.pack(std::forward<Args>(args)...);
+        to_key(&key[0]);
+        return key;
+    }
+
+    /**
+     * @brief decode a key, values have the types Format::unpack returns
+     */
+    std::vector<std::any> unpack(std::string_view key) const;
+
+  private:
+    void to_key(char *data) const noexcept;
+    void from_key(char *data) const noexcept;
+
+    Format m_format;
+};
+
+/**
+ * @brief encode an array as memcmp ordered keys of one numeric code
+ *
+ * Produces the same bytes as KeyFormat with code for every value, vectorized
+ * where the target allows.
+ *
+ * @param code a numeric code, byte order is ignored
+ * @param values
+ * @param n
+ * @param out room for n * php_pack_code_size(code) bytes
+ * @throw std::invalid_argument if code is not numeric
+ */
+template <typename T,
+          typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+void encode_keys(char code, const T *values, size_t n, char *out) {
+    using namespace __phpack__detail;
+    const size_t size = php_pack_code_size(code);
+    if (size == 0) {
+        throw std::invalid_argument(std::string("Type ") + code +
+                                    ": not a fixed width code");
+    }
+    php_key_width(size, [&](auto w) {
+        php_key_encode_array<decltype(w)>(code, values, n, out);
+    });
+}
+
+template <typename T,
+          typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+std::string encode_keys(char code, const T *values, size_t n) {
+    std::string output(n * __phpack__detail::php_pack_code_size(code), '\0');
+    encode_keys(code, values, n, &output[0]);
+    return output;
+}
+
+/**
+ * @brief decode n keys written by encode_keys with the same code
+ * @throw std::invalid_argument if code is not numeric
+ */
+template <typename T,
+          typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+void decode_keys(char code, const char *data, size_t n, T *out) {
+    using namespace __phpack__detail;
+    const size_t size = php_pack_code_size(code);
+    if (size == 0) {
+        throw std::invalid_argument(std::string("Type ") + code +
+                                    ": not a fixed width code");
+    }
+    php_key_width(size, [&](auto w) {
+        php_key_decode_array<decltype(w)>(code, data, n, out);
+    });
+}
+
+} // namespace PhPacker
+
+#endif /* SORT_KEY_H */
@@ -0,0 +1,258 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "unpack_format.h"
+
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace PhPacker {
+
+namespace __phpack__detail {
+
+bool php_unpack_code_is_string(char code) noexcept {
+    return code == 'a' || code == 'A' || code == 'Z' || code == 'h' ||
+           code == 'H';
+}
+
+bool php_unpack_code_is_position(char code) noexcept {
+    return code == 'x' || code == 'X' || code == '@';
+}
+
+void php_unpack_need(char code, size_t need, size_t pos, size_t len) {
+    if (pos + need > len) {
+        throw std::out_of_range(php_type_error(
+            code, "not enough input, need " + std::to_string(need) +
+                      ", have " + std::to_string(len - pos)));
+    }
+}
+
+} // namespace __phpack__detail
+
+std::string_view UnpackResult::key(size_t i) const {
+    if (i >= m_values.size()) {
+        throw std::out_of_range("unpack: no value " + std::to_string(i));
+    }
+    const size_t fixed = m_format->keys().size();
+    if (i < fixed) {
+        return m_format->keys()[i];
+    }
+    return m_star_keys[i - fixed].key;
+}
+
+const std::any *UnpackResult::find(std::string_view key) const noexcept {
+    return m_format ? m_format->find(*this, key) : nullptr;
+}
+
+UnpackFormat::UnpackFormat(std::string_view format) : m_format(format) {
+    using namespace __phpack__detail;
+
+    std::unordered_map<std::string, size_t> slots;
+    size_t i = 0;
+    while (i < format.size()) {
+        element e{format[i++], false, 1, {}, {}, nullptr};
+        php_store_fn store = nullptr;
+
+        if (!php_resolve_codec(e.code, store, e.load) &&
+            !php_unpack_code_is_string(e.code) &&
+            !php_unpack_code_is_position(e.code)) {
+            throw std::invalid_argument(
+                php_type_error(e.code, "unknown format code"));
+        }
+
+        if (i < format.size() && format[i] == '*') {
+            e.star = true;
+            ++i;
+        } else if (i < format.size() && format[i] >= '0' && format[i] <= '9') {
+            e.count = 0;
+            while (i < format.size() && format[i] >= '0' && format[i] <= '9') {
+                e.count = e.count * 10 + static_cast<size_t>(format[i++] - '0');
+                if (e.count > INT_MAX) {
+                    throw std::invalid_argument(
+                        php_type_error(e.code, "integer overflow"));
+                }
+            }
+        }
+
+        const size_t slash = format.find('/', i);
+        const size_t end =
+            slash == std::string_view::npos ? format.size() : slash;
+        e.name = std::string(format.substr(i, end - i));
+        i = slash == std::string_view::npos ? end : end + 1;
+
+        if (php_unpack_code_is_position(e.code)) {
+            /* php treats X* and @* as X and @ */
+            if (e.star && e.code != 'x') {
+                e.star = false;
+                e.count = 1;
+            }
+        } else if (!e.star || php_unpack_code_is_string(e.code)) {
+            /* strings always produce a single value */
+            const size_t values =
+                php_unpack_code_is_string(e.code) ? 1 : e.count;
+            for (size_t n = 0; n < values; ++n) {
+                std::string key = values == 1 && !e.name.empty()
+                                      ? e.name
+                                      : e.name + std::to_string(n + 1);
+                /* like a php array, a repeated key overwrites the value */
+                auto it = slots.find(key);
+                if (it == slots.end()) {
+                    it = slots.emplace(key, m_keys.size()).first;
+                    m_keys.push_back(std::move(key));
+                }
+                e.slots.push_back(it->second);
+            }
+        }
+        m_elements.push_back(std::move(e));
+    }
+
+    m_sorted.resize(m_keys.size());
+    for (size_t k = 0; k < m_sorted.size(); ++k) {
+        m_sorted[k] = k;
+    }
+    std::sort(m_sorted.begin(), m_sorted.end(),
+              [this](size_t a, size_t b) { return m_keys[a] < m_keys[b]; });
+}
+
+const std::string &UnpackFormat::dynamic_key(UnpackResult &result,
+                                             size_t ei, size_t index) const {
+    const size_t j = result.m_values.size() - m_keys.size();
+    if (j == result.m_star_keys.size()) {
+        result.m_star_keys.push_back({ei, index, {}});
+    } else if (result.m_star_keys[j].element == ei &&
+               result.m_star_keys[j].index == index) {
+        return result.m_star_keys[j].key;
+    }
+
+    UnpackResult::star_key &k = result.m_star_keys[j];
+    k.element = ei;
+    k.index = index;
+    k.key = m_elements[ei].name;
+    k.key += std::to_string(index + 1);
+    return k.key;
+}
+
+void UnpackFormat::unpack(std::string_view data, UnpackResult &result) const {
+    using namespace __phpack__detail;
+
+    if (result.m_format != this) {
+        result.m_star_keys.clear();
+    }
+    result.m_format = this;
+    result.m_values.resize(m_keys.size());
+
+    const size_t len = data.size();
+    size_t pos = 0;
+    for (size_t ei = 0; ei < m_elements.size(); ++ei) {
+        const element &e = m_elements[ei];
+
+        switch (e.code) {
+        case 'x':
+            if (e.star) {
+                pos = len;
+            } else {
+                if (pos + e.count > len) {
+                    throw std::out_of_range(
+                        php_type_error(e.code, "outside of string"));
+                }
+                pos += e.count;
+            }
+            break;
+        case 'X':
+            if (e.count > pos) {
+                throw std::out_of_range(
+                    php_type_error(e.code, "outside of string"));
+            }
+            pos -= e.count;
+            break;
+        case '@':
+            if (e.count > len) {
+                throw std::out_of_range(
+                    php_type_error(e.code, "outside of string"));
+            }
+            pos = e.count;
+            break;
+        case 'a':
+        case 'A':
+        case 'Z':
+        case 'h':
+        case 'H': {
+            const bool hex = e.code == 'h' || e.code == 'H';
+            size_t size = e.star ? len - pos : e.count;
+            size_t nibbles = size * 2;
+            if (hex && !e.star) {
+                nibbles = e.count;
+                size = (e.count + 1) / 2;
+            }
+            php_unpack_need(e.code, size, pos, len);
+
+            result.m_values[e.slots[0]] =
+                php_unpack_string(e.code, data.substr(pos, size), nibbles);
+            pos += size;
+            break;
+        }
+        default: {
+            const size_t size = php_pack_code_size(e.code);
+            if (e.star) {
+                for (size_t n = 0; pos + size <= len; ++n, pos += size) {
+                    dynamic_key(result, ei, n);
+                    result.m_values.push_back(e.load(data.data() + pos));
+                }
+            } else {
+                for (size_t slot : e.slots) {
+                    php_unpack_need(e.code, size, pos, len);
+                    result.m_values[slot] = e.load(data.data() + pos);
+                    pos += size;
+                }
+            }
+            break;
+        }
+        }
+    }
+}
+
+const std::any *UnpackFormat::find(const UnpackResult &result,
+                                   std::string_view key) const noexcept {
+    auto it = std::lower_bound(
+        m_sorted.begin(), m_sorted.end(), key,
+        [this](size_t k, std::string_view v) { return m_keys[k] < v; });
+    if (it != m_sorted.end() && m_keys[*it] == key) {
+        return &result.m_values[*it];
+    }
+
+    for (size_t i = m_keys.size(); i < result.m_values.size(); ++i) {
+        if (result.m_star_keys[i - m_keys.size()].key == key) {
+            return &result.m_values[i];
+        }
+    }
+    return nullptr;
+}
+
+} // namespace PhPacker
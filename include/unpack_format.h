@@ -0,0 +1,165 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef UNPACK_FORMAT_H
+#define UNPACK_FORMAT_H
+
+#include "format.h"
+
+#include <any>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace PhPacker {
+
+class UnpackFormat;
+class RecordLayout;
+
+/**
+ * @brief Keyed values produced by UnpackFormat::unpack
+ *
+ * Keys belong to the format, so reusing one result for many messages
+ * only reassigns the values. The format must outlive the result.
+ */
+class UnpackResult {
+  public:
+    size_t size() const noexcept { return m_values.size(); }
+
+    std::string_view key(size_t i) const;
+    const std::any &value(size_t i) const { return m_values.at(i); }
+
+    /**
+     * @brief find
+     * @param key e.g. "len" or "bytes2"
+     * @return the value or nullptr if there is no such key
+     */
+    const std::any *find(std::string_view key) const noexcept;
+
+    /**
+     * @brief get
+     * @param key
+     * @return the value as T
+     * @throw std::out_of_range if there is no such key
+     * @throw std::bad_any_cast if the value is not a T
+     */
+    template <typename T> T get(std::string_view key) const {
+        const std::any *v = find(key);
+        if (!v) {
+            throw std::out_of_range("unpack: no key '" + std::string(key) +
+                                    "'");
+        }
+        return std::any_cast<T>(*v);
+    }
+
+  private:
+    friend class UnpackFormat;
+
+    /* key of a value produced by a '*' repeat, kept across unpacks */
+    struct star_key {
+        size_t element;
+        size_t index;
+        std::string key;
+    };
+
+    const UnpackFormat *m_format = nullptr;
+    std::vector<std::any> m_values;
+    std::vector<star_key> m_star_keys;
+};
+
+/**
+ * @brief A php unpack() format such as "Nlen/nflags/C4bytes"
+ *
+ * Elements are separated by '/', each is a code, an optional repeat count
+ * or '*' and an optional name. Keys follow php: a repeated element named
+ * "bytes" yields "bytes1", "bytes2"..., unnamed values are numbered.
+ * String codes a, A, Z, h and H and the positioning codes x, X and @ are
+ * supported along with every numeric code.
+ */
+class UnpackFormat {
+  public:
+    /**
+     * @brief UnpackFormat
+     * @param format
+     * @throw std::invalid_argument for unknown codes or bad repeat counts
+     */
+    explicit UnpackFormat(std::string_view format);
+
+    const std::string &str() const noexcept { return m_format; }
+
+    /**
+     * @brief keys of every value except those of numeric '*' repeats,
+     * which follow them in the result
+     */
+    const std::vector<std::string> &keys() const noexcept { return m_keys; }
+
+    /**
+     * @brief unpack
+     * @param data
+     * @param result reused, its previous values are replaced
+     * @throw std::out_of_range if data is too short
+     */
+    void unpack(std::string_view data, UnpackResult &result) const;
+
+    UnpackResult unpack(std::string_view data) const {
+        UnpackResult result;
+        unpack(data, result);
+        return result;
+    }
+
+  private:
+    friend class UnpackResult;
+    friend class RecordLayout;
+
+    struct element {
+        char code;
+        bool star;
+        size_t count;
+        std::string name;
+        /* value slot of every repetition, empty for x, X, @ and numeric '*' */
+        std::vector<size_t> slots;
+        __phpack__detail::php_load_fn load;
+    };
+
+    const std::any *find(const UnpackResult &result,
+                         std::string_view key) const noexcept;
+    /* key of the index-th value of a '*' repeated element */
+    const std::string &dynamic_key(UnpackResult &result, size_t ei,
+                                   size_t index) const;
+
+    std::string m_format;
+    std::vector<element> m_elements;
+    std::vector<std::string> m_keys;
+    /* indices into m_keys, sorted by key */
+    std::vector<size_t> m_sorted;
+};
+
+} // namespace PhPacker
+
+#endif /* UNPACK_FORMAT_H */
@@ -0,0 +1,132 @@
+#include "../include/batch.h"
+
+#include "gtest/gtest.h"
+#include <array>
+#include <cmath>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+struct Trade {
+    uint32_t id;
+    int16_t venue;
+    double price;
+    uint64_t stamp;
+};
+
+auto phpack_tie(Trade &t) { return std::tie(t.id, t.venue, t.price, t.stamp); }
+
+using Row = std::tuple<uint32_t, int16_t, double, uint64_t>;
+
+constexpr const char *row_format = "NvxEJ";
+
+std::vector<Row> rows(size_t n)
+{
+    std::vector<Row> v;
+    for (size_t i = 0; i < n; ++i) {
+        v.emplace_back(static_cast<uint32_t>(i * 2654435761u),
+                       static_cast<int16_t>(i % 2000) - 1000,
+                       static_cast<double>(i) / 8, i << 20);
+    }
+    return v;
+}
+
+} // namespace
+
+TEST(PhPackerBatch, SameAsPerRecord)
+{
+    const PhPacker::Format format(row_format);
+    /* several tiles and a partial one */
+    const std::vector<Row> v = rows(2000);
+    std::string expected;
+    for (const Row &r : v) {
+        expected += format.pack(std::get<0>(r), std::get<1>(r), std::get<2>(r),
+                                std::get<3>(r));
+    }
+    const std::string packed = PhPacker::pack_batch(format, v);
+    EXPECT_EQ(packed, expected);
+
+    const auto decoded = PhPacker::unpack_batch<Row>(format, packed);
+    EXPECT_EQ(decoded, v);
+}
+
+TEST(PhPackerBatch, Structs)
+{
+    const PhPacker::Format format("VsdQ");
+    const std::vector<Trade> trades = {{7, -3, 101.25, 1u << 31},
+                                       {0xffffffff, 32767, -0.5, 42}};
+    const std::string packed = PhPacker::pack_batch(format, trades);
+    ASSERT_EQ(packed.size(), 2 * format.size());
+    EXPECT_EQ(packed.substr(0, format.size()),
+              format.pack(7u, -3, 101.25, uint64_t{1} << 31));
+
+    std::array<Trade, 2> decoded{};
+    PhPacker::unpack_batch(format, packed, decoded.data(), decoded.size());
+    for (size_t i = 0; i < 2; ++i) {
+        EXPECT_EQ(decoded[i].id, trades[i].id);
+        EXPECT_EQ(decoded[i].venue, trades[i].venue);
+        EXPECT_EQ(decoded[i].price, trades[i].price);
+        EXPECT_EQ(decoded[i].stamp, trades[i].stamp);
+    }
+}
+
+TEST(PhPackerBatch, TupleLike)
+{
+    const PhPacker::Format format("n3");
+    const std::vector<std::array<int, 3>> v = {{1, 2, 3}, {4, 5, 6}};
+    EXPECT_EQ(PhPacker::pack_batch(format, v),
+              std::string("\0\1\0\2\0\3\0\4\0\5\0\6", 12));
+
+    const PhPacker::Format pair_format("Cg");
+    using Pair = std::pair<uint8_t, float>;
+    const std::vector<Pair> pairs = {{9, 1.5f}};
+    const std::string packed = PhPacker::pack_batch(pair_format, pairs);
+    EXPECT_EQ(PhPacker::unpack_batch<Pair>(pair_format, packed), pairs);
+}
+
+TEST(PhPackerBatch, Conversion)
+{
+    const std::vector<std::tuple<int, int>> v = {{1, 2}, {3, 70000}, {-1, 4}};
+
+    const PhPacker::Format wrap("nn");
+    EXPECT_EQ(PhPacker::pack_batch(wrap, v).substr(6, 2),
+              PhPacker::pack('n', 70000));
+
+    const PhPacker::Format check("nn", PhPacker::Conversion::Check);
+    try {
+        PhPacker::pack_batch(check, v);
+        FAIL() << "no RangeError";
+    } catch (const PhPacker::RangeError &e) {
+        EXPECT_EQ(e.code(), 'n');
+        EXPECT_EQ(e.index(), 1);
+    }
+
+    const PhPacker::Format saturate("nn", PhPacker::Conversion::Saturate);
+    EXPECT_EQ(PhPacker::pack_batch(saturate, v),
+              std::string("\0\1\0\2\0\3\xff\xff\0\0\0\4", 12));
+}
+
+TEST(PhPackerBatch, Errors)
+{
+    using Pair = std::tuple<int, int>;
+    const std::vector<Pair> v = {{1, 2}};
+    EXPECT_THROW(PhPacker::pack_batch(PhPacker::Format("nnn"), v),
+                 std::invalid_argument);
+    EXPECT_THROW(PhPacker::pack_batch(PhPacker::Format("na2"), v),
+                 std::invalid_argument);
+    EXPECT_THROW(PhPacker::pack_batch(PhPacker::Format("nb4b4"), v),
+                 std::invalid_argument);
+    EXPECT_THROW(PhPacker::pack_batch(PhPacker::Format("na*"), v),
+                 std::invalid_argument);
+
+    Pair out;
+    EXPECT_THROW(PhPacker::unpack_batch(PhPacker::Format("nn"),
+                                        std::string_view("\0\1\0", 3), &out,
+                                        1),
+                 std::out_of_range);
+    EXPECT_TRUE(PhPacker::unpack_batch<Pair>(PhPacker::Format("nn"),
+                                             std::string_view("\0\1\0", 3))
+                    .empty());
+}
@@ -0,0 +1,79 @@
+#include "../include/bitfield.h"
+#include "../include/format.h"
+#include "../include/gather.h"
+
+#include "gtest/gtest.h"
+#include <vector>
+
+using Telemetry = PhPacker::BitFields<PhPacker::BitOrder::MsbFirst, 3, 12, 1>;
+using Flags = PhPacker::BitFields<PhPacker::BitOrder::LsbFirst, 1, 1, 6, 4>;
+
+TEST(PhPackerBitFields, Layout)
+{
+    static_assert(Telemetry::size == 2);
+    static_assert(Telemetry::shifts[0] == 13);
+    static_assert(Telemetry::shifts[1] == 1);
+    static_assert(Telemetry::shifts[2] == 0);
+    static_assert(Telemetry::masks[1] == 0xfff);
+    static_assert(Telemetry::encode({5, 0xabc, 1}) == 0xb579);
+    static_assert(Telemetry::get<1>(0xb579) == 0xabc);
+
+    static_assert(Flags::size == 2);
+    static_assert(Flags::shifts[3] == 8);
+    static_assert(PhPacker::BitFields<PhPacker::BitOrder::MsbFirst, 64>::size ==
+                  8);
+}
+
+TEST(PhPackerBitFields, PackUnpack)
+{
+    char buf[2];
+    Telemetry::pack({5, 0xabc, 1}, buf);
+    EXPECT_EQ(std::string(buf, 2), "\xb5\x79");
+    EXPECT_EQ(Telemetry::unpack(buf), (Telemetry::values{5, 0xabc, 1}));
+
+    /* too wide values are truncated to their field */
+    Telemetry::pack({13, 0x1abc, 3}, buf);
+    EXPECT_EQ(Telemetry::unpack(buf), (Telemetry::values{5, 0xabc, 1}));
+
+    Flags::pack({1, 0, 0x2a, 0xf}, buf);
+    EXPECT_EQ(std::string(buf, 2), "\xa9\x0f");
+}
+
+TEST(PhPackerBitFields, Arrays)
+{
+    std::vector<Telemetry::values> records;
+    for (uint64_t i = 0; i < 100; ++i) {
+        records.push_back({i % 8, i * 37 % 4096, i % 2});
+    }
+    std::string str(records.size() * Telemetry::size, '\0');
+    Telemetry::pack_array(records.data(), records.size(), &str[0]);
+
+    std::vector<Telemetry::values> decoded(records.size());
+    Telemetry::unpack_array(str.data(), decoded.size(), decoded.data());
+    EXPECT_EQ(decoded, records);
+}
+
+TEST(PhPackerBitFields, Format)
+{
+    PhPacker::Format format("nB3B12B1b1b1b6b4C");
+    EXPECT_EQ(format.size(), 7u);
+    EXPECT_EQ(format.args(), 9u);
+
+    std::string str = format.pack(1, 5, 0xabc, 1, 1, 0, 0x2a, 0xf, 7);
+    EXPECT_EQ(str, std::string("\x00\x01\xb5\x79\xa9\x0f\x07", 7));
+
+    auto values = format.unpack(str);
+    ASSERT_EQ(values.size(), 9u);
+    EXPECT_EQ(std::any_cast<uint64_t>(values[2]), 0xabcu);
+    EXPECT_EQ(std::any_cast<uint64_t>(values[6]), 0x2au);
+    EXPECT_EQ(std::any_cast<unsigned char>(values[8]), 7);
+
+    PhPacker::GatherOutput output;
+    PhPacker::pack_gather(output, format, 1, 5, 0xabc, 1, 1, 0, 0x2a, 0xf, 7);
+    EXPECT_EQ(output.str(), str);
+
+    /* a group holds at most 64 bits */
+    EXPECT_EQ(PhPacker::Format("B60B8").size(), 9u);
+    EXPECT_THROW(PhPacker::Format("B65"), std::invalid_argument);
+    EXPECT_THROW(PhPacker::Format("b*"), std::invalid_argument);
+}
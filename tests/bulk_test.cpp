@@ -0,0 +1,188 @@
+#include "../include/bulk.h"
+#include "../include/format.h"
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+TEST(PhPackerBulk, MatchesPack)
+{
+    const std::vector<int64_t> values = {0, 1, -1, 65535, -77,
+                                         std::numeric_limits<int64_t>::min(),
+                                         std::numeric_limits<int64_t>::max()};
+    for (char code : std::string("cCsSnviIlLNVqQJPfgGdeE")) {
+        std::string expected;
+        for (int64_t v : values) {
+            if (PhPacker::__phpack__detail::php_pack_code_is_float(code)) {
+                expected += PhPacker::pack(std::string(1, code),
+                                           static_cast<double>(v));
+            } else {
+                expected += PhPacker::pack(std::string(1, code), v);
+            }
+        }
+
+        std::string str;
+        if (PhPacker::__phpack__detail::php_pack_code_is_float(code)) {
+            std::vector<double> doubles(values.begin(), values.end());
+            str = PhPacker::pack_array(code, doubles.data(), doubles.size());
+        } else {
+            str = PhPacker::pack_array(code, values.data(), values.size());
+        }
+        EXPECT_EQ(str, expected) << "code " << code;
+    }
+}
+
+TEST(PhPackerBulk, RoundTrip)
+{
+    std::vector<uint32_t> values(1000);
+    std::iota(values.begin(), values.end(), 4000000000u);
+    std::string str = PhPacker::pack_array('N', values.data(), values.size());
+    ASSERT_EQ(str.size(), values.size() * 4);
+
+    std::vector<uint32_t> decoded(values.size());
+    PhPacker::unpack_array('N', str.data(), decoded.size(), decoded.data());
+    EXPECT_EQ(decoded, values);
+
+    std::vector<int16_t> shorts = {-1, -32768, 32767};
+    str = PhPacker::pack_array('s', shorts.data(), shorts.size());
+    std::vector<int64_t> widened(shorts.size());
+    PhPacker::unpack_array('s', str.data(), widened.size(), widened.data());
+    EXPECT_EQ(widened, std::vector<int64_t>({-1, -32768, 32767}));
+
+    EXPECT_THROW(PhPacker::pack_array('a', shorts.data(), shorts.size()),
+                 std::invalid_argument);
+}
+
+TEST(PhPackerBulk, Parallel)
+{
+    std::vector<uint64_t> values(200000);
+    std::iota(values.begin(), values.end(), 1ull << 40);
+    const std::string expected =
+        PhPacker::pack_array('J', values.data(), values.size());
+
+    EXPECT_EQ(PhPacker::pack_array_parallel('J', values.data(), values.size()),
+              expected);
+
+    /* a user supplied executor, here running every chunk inline */
+    std::atomic<int> tasks{0};
+    auto inline_executor = [&](std::function<void()> task) {
+        ++tasks;
+        task();
+    };
+    std::string str(expected.size(), '\0');
+    PhPacker::pack_array_parallel('J', values.data(), values.size(), &str[0],
+                                  inline_executor, 7);
+    EXPECT_EQ(str, expected);
+    EXPECT_EQ(tasks, 7);
+
+    /* an explicit count is kept for small arrays, up to one per value */
+    tasks = 0;
+    EXPECT_EQ(PhPacker::pack_array_parallel('J', values.data(), 1000,
+                                            inline_executor, 4),
+              expected.substr(0, 8000));
+    EXPECT_EQ(tasks, 4);
+    tasks = 0;
+    EXPECT_EQ(PhPacker::pack_array_parallel('J', values.data(), 3,
+                                            inline_executor, 4),
+              expected.substr(0, 24));
+    EXPECT_EQ(tasks, 3);
+
+    /* the third chunk fails to start, the first two must finish first */
+    std::atomic<int> finished{0};
+    tasks = 0;
+    auto failing_executor = [&](std::function<void()> task) {
+        if (tasks == 2) {
+            throw std::system_error(std::make_error_code(
+                std::errc::resource_unavailable_try_again));
+        }
+        ++tasks;
+        std::thread([&finished, task = std::move(task)] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            task();
+            ++finished;
+        }).detach();
+    };
+    std::fill(str.begin(), str.end(), '\0');
+    EXPECT_THROW(PhPacker::pack_array_parallel('J', values.data(),
+                                               values.size(), &str[0],
+                                               failing_executor, 7),
+                 std::system_error);
+    EXPECT_EQ(tasks, 2);
+    const size_t packed = 2 * ((values.size() + 6) / 7) * 8;
+    EXPECT_EQ(str.substr(0, packed), expected.substr(0, packed));
+    /* both tasks have passed their last use of the shared state */
+    while (finished != 2) {
+        std::this_thread::yield();
+    }
+}
+
+TEST(PhPackerBulk, Conversion)
+{
+    using PhPacker::Conversion;
+    std::vector<uint32_t> values(5000, 7);
+    values[4321] = 70000;
+    values[4500] = 65536;
+
+    std::vector<char> out(values.size() * 2, 'x');
+    try {
+        PhPacker::pack_array('n', values.data(), values.size(), out.data(),
+                             Conversion::Check);
+        FAIL() << "expected a RangeError";
+    } catch (const PhPacker::RangeError &e) {
+        EXPECT_EQ(e.index(), 4321);
+        EXPECT_EQ(e.code(), 'n');
+    }
+    EXPECT_EQ(out[4096 * 2 - 1], 7);
+    EXPECT_EQ(out[4096 * 2], 'x');
+
+    const std::string saturated = PhPacker::pack_array(
+        'n', values.data(), values.size(), Conversion::Saturate);
+    std::vector<uint32_t> decoded(values.size());
+    PhPacker::unpack_array('n', saturated.data(), decoded.size(),
+                           decoded.data());
+    EXPECT_EQ(decoded[0], 7);
+    EXPECT_EQ(decoded[4321], 65535);
+    EXPECT_EQ(decoded[4500], 65535);
+    EXPECT_EQ(PhPacker::pack_array('n', values.data(), values.size(),
+                                   Conversion::Wrap),
+              PhPacker::pack_array('n', values.data(), values.size()));
+
+    const int64_t ints[] = {-200, -128, 0, 127, 300};
+    const std::string c =
+        PhPacker::pack_array('c', ints, 5, Conversion::Saturate);
+    EXPECT_EQ(c, std::string("\x80\x80\x00\x7f\x7f", 5));
+    EXPECT_EQ(PhPacker::pack_array('C', ints, 5, Conversion::Saturate),
+              std::string("\x00\x00\x00\x7f\xff", 5));
+    EXPECT_NO_THROW(PhPacker::pack_array('q', ints, 5, Conversion::Check));
+
+    const double doubles[] = {-1.5, 1e10, std::nan(""), 255.9, 1e40};
+    std::vector<int64_t> back(5);
+    PhPacker::unpack_array(
+        'C', PhPacker::pack_array('C', doubles, 5, Conversion::Saturate).data(),
+        5, back.data());
+    EXPECT_EQ(back, (std::vector<int64_t>{0, 255, 0, 255, 255}));
+    try {
+        PhPacker::pack_array('N', doubles, 5, Conversion::Check);
+        FAIL() << "expected a RangeError";
+    } catch (const PhPacker::RangeError &e) {
+        EXPECT_EQ(e.index(), 0);
+    }
+    try {
+        PhPacker::pack_array('G', doubles, 5, Conversion::Check);
+        FAIL() << "expected a RangeError";
+    } catch (const PhPacker::RangeError &e) {
+        EXPECT_EQ(e.index(), 4);
+    }
+    std::vector<float> floats(5);
+    PhPacker::unpack_array(
+        'G', PhPacker::pack_array('G', doubles, 5, Conversion::Saturate).data(),
+        5, floats.data());
+    EXPECT_EQ(floats[4], std::numeric_limits<float>::max());
+}
@@ -0,0 +1,91 @@
+#include "../include/crc32c.h"
+#include "../include/gather.h"
+
+#include "gtest/gtest.h"
+#include <string>
+
+TEST(PhPackerCrc32c, Known)
+{
+    EXPECT_EQ(PhPacker::crc32c(""), 0u);
+    EXPECT_EQ(PhPacker::crc32c("123456789"), 0xe3069283u);
+    EXPECT_EQ(PhPacker::crc32c(std::string(32, '\0')), 0x8a9136aau);
+
+    /* every length and alignment against one byte at a time */
+    std::string data;
+    for (int i = 0; i < 300; ++i) {
+        data.push_back(static_cast<char>(i * 7 + 3));
+    }
+    for (size_t start = 0; start < 9; ++start) {
+        for (size_t n = 0; n + start <= data.size(); n += 13) {
+            uint32_t crc = 0;
+            for (size_t i = 0; i < n; ++i) {
+                crc = PhPacker::crc32c(data.substr(start + i, 1), crc);
+            }
+            EXPECT_EQ(PhPacker::crc32c(data.substr(start, n)), crc)
+                << start << " " << n << " " << PhPacker::crc32c_kernel();
+            EXPECT_EQ(~PhPacker::__phpack__detail::php_crc32c_software(
+                          ~0u, data.data() + start, n),
+                      crc);
+        }
+    }
+}
+
+TEST(PhPackerCrc32c, Trailer)
+{
+    const PhPacker::Format format("Nna*");
+    const std::string record =
+        PhPacker::pack_crc32c(format, 'N', 7, 3, std::string_view("body"));
+    const std::string plain = format.pack(7, 3, std::string_view("body"));
+    EXPECT_EQ(record.substr(0, plain.size()), plain);
+    EXPECT_EQ(record.substr(plain.size()),
+              PhPacker::pack('N', PhPacker::crc32c(plain)));
+
+    const auto values = PhPacker::unpack_crc32c(format, record);
+    EXPECT_EQ(std::any_cast<std::string>(values[2]), "body");
+
+    std::string corrupt = record;
+    corrupt[5] ^= 0x10;
+    EXPECT_THROW(PhPacker::unpack_crc32c(format, corrupt),
+                 PhPacker::IntegrityError);
+    corrupt = record;
+    corrupt[plain.size() - 1] ^= 0x01;
+    EXPECT_THROW(PhPacker::unpack_crc32c(format, corrupt),
+                 PhPacker::IntegrityError);
+
+    /* bytes past the last field are still covered */
+    const PhPacker::Format head("Nn");
+    EXPECT_EQ(PhPacker::unpack_crc32c(head, record).size(), 2u);
+    /* a short record is corrupt first and short second */
+    const std::string short_record = PhPacker::pack_crc32c(head, 'N', 7, 3);
+    EXPECT_THROW(PhPacker::unpack_crc32c(PhPacker::Format("NnN"), short_record),
+                 std::out_of_range);
+    corrupt = short_record;
+    corrupt[0] ^= 0x01;
+    EXPECT_THROW(PhPacker::unpack_crc32c(PhPacker::Format("NnN"), corrupt),
+                 PhPacker::IntegrityError);
+    EXPECT_THROW(PhPacker::verify_crc32c(record, 'V'),
+                 PhPacker::IntegrityError);
+    EXPECT_THROW(PhPacker::verify_crc32c("abc"), PhPacker::IntegrityError);
+    EXPECT_THROW(PhPacker::pack_crc32c(format, 'n', 1, 2, std::string_view()),
+                 std::invalid_argument);
+
+    std::string le = plain;
+    PhPacker::append_crc32c(le, 'V');
+    EXPECT_EQ(PhPacker::verify_crc32c(le, 'V'), plain);
+}
+
+TEST(PhPackerCrc32c, Gather)
+{
+    const PhPacker::Format format("Na*");
+    const std::string payload(1000, 'g');
+    PhPacker::GatherOutput output;
+    PhPacker::pack_gather(output, format, 1, payload);
+    output.append_crc32c();
+    PhPacker::pack_gather(output, format, 2, std::string_view("short"));
+    output.append_crc32c('V');
+
+    const std::string expected =
+        PhPacker::pack_crc32c(format, 'N', 1, payload) +
+        PhPacker::pack_crc32c(format, 'V', 2, std::string_view("short"));
+    EXPECT_EQ(output.str(), expected);
+}
@@ -0,0 +1,83 @@
+#include "../include/delta.h"
+
+#include "gtest/gtest.h"
+#include <limits>
+#include <vector>
+
+namespace {
+
+std::vector<int64_t> timestamps(size_t n)
+{
+    std::vector<int64_t> values;
+    int64_t t = 1600000000000;
+    for (size_t i = 0; i < n; ++i) {
+        t += 1000 + static_cast<int64_t>(i % 3) - 1;
+        values.push_back(t);
+    }
+    return values;
+}
+
+void round_trip(const std::vector<int64_t> &values, PhPacker::DeltaMode mode,
+                char code)
+{
+    const std::string str =
+        PhPacker::pack_delta(values.data(), values.size(), mode, code);
+    std::vector<int64_t> decoded(values.size());
+    EXPECT_EQ(PhPacker::unpack_delta(str, decoded.size(), decoded.data(), mode,
+                                     code),
+              str.size());
+    EXPECT_EQ(decoded, values) << "code " << (code ? code : '0');
+}
+
+} // namespace
+
+TEST(PhPackerDelta, RoundTrip)
+{
+    const auto values = timestamps(1001);
+    for (auto mode :
+         {PhPacker::DeltaMode::Delta, PhPacker::DeltaMode::DeltaOfDelta}) {
+        round_trip(values, mode, 0);
+        round_trip(values, mode, 'q');
+        round_trip({}, mode, 0);
+        round_trip({42}, mode, 0);
+        round_trip({42, -42}, mode, 0);
+        round_trip({std::numeric_limits<int64_t>::min(),
+                    std::numeric_limits<int64_t>::max(), 0, -1},
+                   mode, 0);
+    }
+    round_trip(values, PhPacker::DeltaMode::Delta, 'n');
+    round_trip(values, PhPacker::DeltaMode::DeltaOfDelta, 'c');
+}
+
+TEST(PhPackerDelta, Size)
+{
+    const auto values = timestamps(1000);
+    /* deltas around 1000 take two varint bytes, the changes one */
+    EXPECT_EQ(PhPacker::pack_delta(values.data(), values.size()).size(),
+              8u + 999 * 2);
+    EXPECT_EQ(PhPacker::pack_delta(values.data(), values.size(),
+                                   PhPacker::DeltaMode::DeltaOfDelta)
+                  .size(),
+              16u + 998);
+    EXPECT_EQ(PhPacker::pack_delta(values.data(), values.size(),
+                                   PhPacker::DeltaMode::Delta, 'v')
+                  .size(),
+              8u + 999 * 2);
+}
+
+TEST(PhPackerDelta, Errors)
+{
+    const auto values = timestamps(10);
+    EXPECT_THROW(PhPacker::pack_delta(values.data(), values.size(),
+                                      PhPacker::DeltaMode::Delta, 'c'),
+                 std::out_of_range);
+    EXPECT_THROW(PhPacker::pack_delta(values.data(), values.size(),
+                                      PhPacker::DeltaMode::Delta, 'f'),
+                 std::invalid_argument);
+
+    const std::string str = PhPacker::pack_delta(values.data(), values.size());
+    std::vector<int64_t> decoded(values.size());
+    EXPECT_THROW(PhPacker::unpack_delta(str.substr(0, str.size() - 1),
+                                        decoded.size(), decoded.data()),
+                 std::out_of_range);
+}
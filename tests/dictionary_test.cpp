@@ -0,0 +1,160 @@
+#include "../include/dictionary.h"
+
+#include "gtest/gtest.h"
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+struct Request {
+    uint32_t id;
+    std::string host;
+    std::string_view status;
+    uint16_t millis;
+};
+
+auto phpack_tie(Request &r)
+{
+    return std::tie(r.id, r.host, r.status, r.millis);
+}
+
+const char *const hosts[] = {"web-01.example.com", "web-02.example.com",
+                             "db-01.example.com"};
+const char *const statuses[] = {"ok", "not found", "error"};
+
+std::vector<Request> requests(size_t n)
+{
+    std::vector<Request> v;
+    for (size_t i = 0; i < n; ++i) {
+        v.push_back({static_cast<uint32_t>(i), hosts[i % 3],
+                     statuses[i % 7 % 3], static_cast<uint16_t>(i * 3)});
+    }
+    return v;
+}
+
+} // namespace
+
+TEST(PhPackerDictionary, Add)
+{
+    PhPacker::StringDictionary d;
+    EXPECT_TRUE(d.empty());
+    EXPECT_EQ(d.add("a"), 0);
+    EXPECT_EQ(d.add("bb"), 1);
+    EXPECT_EQ(d.add("a"), 0);
+    EXPECT_EQ(d.add(""), 2);
+    EXPECT_EQ(d.add(std::string("bb")), 1);
+    ASSERT_EQ(d.size(), 3);
+    EXPECT_EQ(d[1], "bb");
+    EXPECT_EQ(d.pack(),
+              PhPacker::Format("NNa1Na2N").pack(3, 1, "a", 2, "bb", 0));
+
+    /* past several rehashes */
+    for (size_t i = 0; i < 5000; ++i) {
+        EXPECT_EQ(d.add("key" + std::to_string(i)), i + 3);
+    }
+    for (size_t i = 0; i < 5000; i += 7) {
+        EXPECT_EQ(d.add("key" + std::to_string(i)), i + 3);
+    }
+    EXPECT_EQ(d[4002], "key3999");
+
+    d.clear();
+    EXPECT_TRUE(d.empty());
+    EXPECT_EQ(d.pack(), std::string(4, '\0'));
+    EXPECT_EQ(d.add("key10"), 0);
+    EXPECT_EQ(d.add("a"), 1);
+}
+
+TEST(PhPackerDictionary, Table)
+{
+    PhPacker::StringDictionary d;
+    d.add("x");
+    d.add("");
+    d.add("yz");
+    const std::string packed = d.pack() + "rest";
+    std::vector<std::string_view> table{"stale"};
+    EXPECT_EQ(PhPacker::unpack_dictionary(packed, table), "rest");
+    ASSERT_EQ(table.size(), 3);
+    EXPECT_EQ(table[0], "x");
+    EXPECT_EQ(table[1], "");
+    EXPECT_EQ(table[2], "yz");
+
+    for (size_t n = 0; n < d.packed_size(); ++n) {
+        EXPECT_THROW(PhPacker::unpack_dictionary(packed.substr(0, n), table),
+                     std::out_of_range)
+            << n;
+    }
+}
+
+TEST(PhPackerDictionary, Batch)
+{
+    const PhPacker::Format format("NCnv");
+    const std::vector<Request> v = requests(3000);
+    PhPacker::StringDictionary d;
+    const std::string packed = PhPacker::pack_batch(format, v, d);
+    EXPECT_EQ(d.size(), 6);
+    EXPECT_EQ(packed.size(), d.packed_size() + v.size() * format.size());
+
+    /* indexes follow first use, one field at a time: hosts, then statuses */
+    const auto first = format.unpack(
+        std::string_view(packed).substr(d.packed_size(), format.size()));
+    EXPECT_EQ(std::any_cast<uint32_t>(first[0]), 0);
+    EXPECT_EQ(std::any_cast<uint8_t>(first[1]), 0);
+    EXPECT_EQ(std::any_cast<uint16_t>(first[2]), 3);
+
+    std::vector<std::string_view> table;
+    const auto decoded = PhPacker::unpack_batch<Request>(format, packed, table);
+    ASSERT_EQ(decoded.size(), v.size());
+    for (size_t i = 0; i < v.size(); ++i) {
+        EXPECT_EQ(decoded[i].id, v[i].id);
+        EXPECT_EQ(decoded[i].host, v[i].host);
+        EXPECT_EQ(decoded[i].status, v[i].status);
+        EXPECT_EQ(decoded[i].millis, v[i].millis);
+    }
+    /* views point into the packed table */
+    EXPECT_GE(decoded[0].status.data(), packed.data());
+    EXPECT_LT(decoded[0].status.data(), packed.data() + d.packed_size());
+
+    /* a reused dictionary starts over */
+    const std::vector<Request> small = {{1, "other", "ok", 2}};
+    const std::string again = PhPacker::pack_batch(format, small, d);
+    EXPECT_EQ(d.size(), 2);
+    EXPECT_EQ(PhPacker::unpack_batch<Request>(format, again, table)[0].host,
+              "other");
+}
+
+TEST(PhPackerDictionary, Errors)
+{
+    using Row = std::tuple<std::string, int>;
+    std::vector<Row> rows;
+    for (int i = 0; i < 300; ++i) {
+        rows.emplace_back(std::to_string(i), i);
+    }
+    PhPacker::StringDictionary d;
+    try {
+        PhPacker::pack_batch(PhPacker::Format("Cn"), rows, d);
+        FAIL() << "no RangeError";
+    } catch (const PhPacker::RangeError &e) {
+        EXPECT_EQ(e.code(), 'C');
+        EXPECT_EQ(e.index(), 256);
+    }
+    EXPECT_NO_THROW(PhPacker::pack_batch(PhPacker::Format("nn"), rows, d));
+    EXPECT_THROW(PhPacker::pack_batch(PhPacker::Format("gn"), rows, d),
+                 std::invalid_argument);
+
+    const std::string packed =
+        PhPacker::pack_batch(PhPacker::Format("nn"), rows, d);
+    std::vector<std::string_view> table;
+    const std::string_view records = PhPacker::unpack_dictionary(packed, table);
+    table.pop_back();
+    std::vector<Row> out(rows.size());
+    EXPECT_THROW(PhPacker::unpack_batch(PhPacker::Format("nn"), records,
+                                        out.data(), out.size(), table),
+                 std::out_of_range);
+    EXPECT_THROW(PhPacker::unpack_batch<Row>(PhPacker::Format("nn"), records),
+                 std::invalid_argument);
+    /* an empty format has no record size to divide by */
+    EXPECT_THROW(PhPacker::unpack_batch<Row>(PhPacker::Format(""), packed,
+                                             table),
+                 std::invalid_argument);
+}
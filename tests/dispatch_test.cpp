@@ -0,0 +1,201 @@
+#include "../include/bulk.h"
+#include "../include/dispatch.h"
+#include "../include/format.h"
+
+#include "gtest/gtest.h"
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+using PhPacker::Isa;
+using PhPacker::__phpack__detail::php_kernel_table;
+using PhPacker::__phpack__detail::php_kernels;
+
+const Isa all_isas[] = {Isa::Scalar, Isa::SSE42, Isa::AVX2, Isa::AVX512,
+                        Isa::ArmV8};
+
+std::vector<const php_kernels *> supported_kernels()
+{
+    std::vector<const php_kernels *> kernels;
+    for (Isa isa : all_isas) {
+        if (PhPacker::isa_supported(isa)) {
+            kernels.push_back(&php_kernel_table(isa));
+        }
+    }
+    return kernels;
+}
+
+std::string bytes(size_t n)
+{
+    std::string s(n, '\0');
+    for (size_t i = 0; i < n; ++i) {
+        s[i] = static_cast<char>(i * 167 + 13);
+    }
+    return s;
+}
+
+} // namespace
+
+TEST(PhPackerDispatch, Selection)
+{
+    EXPECT_TRUE(PhPacker::isa_supported(Isa::Scalar));
+    EXPECT_TRUE(PhPacker::isa_supported(PhPacker::cpu_isa()));
+    EXPECT_TRUE(PhPacker::isa_supported(PhPacker::kernel_isa()));
+    EXPECT_EQ(php_kernel_table().isa, PhPacker::kernel_isa());
+
+    using PhPacker::__phpack__detail::php_select_isa;
+    EXPECT_EQ(php_select_isa("scalar"), Isa::Scalar);
+    EXPECT_EQ(php_select_isa(nullptr), PhPacker::cpu_isa());
+    EXPECT_EQ(php_select_isa("mmx"), PhPacker::cpu_isa());
+    for (Isa isa : all_isas) {
+        EXPECT_EQ(php_select_isa(PhPacker::isa_name(isa)),
+                  PhPacker::isa_supported(isa) ? isa : PhPacker::cpu_isa());
+        EXPECT_EQ(php_kernel_table(isa).isa,
+                  PhPacker::isa_supported(isa) ? isa : Isa::Scalar);
+    }
+}
+
+TEST(PhPackerDispatch, ByteSwap)
+{
+    const php_kernels &scalar = php_kernel_table(Isa::Scalar);
+    const std::string src = bytes(1100);
+    for (const php_kernels *k : supported_kernels()) {
+        for (size_t offset = 0; offset < 4; ++offset) {
+            for (size_t n : {0u, 1u, 3u, 7u, 8u, 15u, 16u, 33u, 64u, 127u}) {
+                const char *s = src.data() + offset;
+                std::string expected(8 * n, '\0');
+                std::string got(8 * n, '\0');
+                scalar.bswap16(s, n, &expected[0]);
+                k->bswap16(s, n, &got[0]);
+                EXPECT_EQ(got, expected) << PhPacker::isa_name(k->isa) << n;
+                scalar.bswap32(s, n, &expected[0]);
+                k->bswap32(s, n, &got[0]);
+                EXPECT_EQ(got, expected) << PhPacker::isa_name(k->isa) << n;
+                scalar.bswap64(s, n, &expected[0]);
+                k->bswap64(s, n, &got[0]);
+                EXPECT_EQ(got, expected) << PhPacker::isa_name(k->isa) << n;
+            }
+        }
+    }
+    std::string v("\1\2\3\4\5\6\7\10", 8);
+    scalar.bswap32(v.data(), 2, &v[0]);
+    EXPECT_EQ(v, std::string("\4\3\2\1\10\7\6\5", 8));
+}
+
+TEST(PhPackerDispatch, Hex)
+{
+    const php_kernels &scalar = php_kernel_table(Isa::Scalar);
+    const std::string src = bytes(300);
+    std::string digits(600, '\0');
+    for (size_t i = 0; i < digits.size(); ++i) {
+        digits[i] = "0123456789abcdefABCDEF"[(i * 7) % 22];
+    }
+    for (const php_kernels *k : supported_kernels()) {
+        for (size_t nibbles :
+             {0u, 1u, 2u, 31u, 32u, 33u, 63u, 64u, 65u, 200u, 513u}) {
+            for (bool high_first : {true, false}) {
+                std::string expected(nibbles, '\0');
+                std::string got(nibbles, '\0');
+                scalar.hex_encode(src.data(), nibbles, &expected[0],
+                                  high_first);
+                k->hex_encode(src.data(), nibbles, &got[0], high_first);
+                EXPECT_EQ(got, expected) << PhPacker::isa_name(k->isa);
+
+                std::string expected_bytes((nibbles + 1) / 2, '\0');
+                std::string got_bytes((nibbles + 1) / 2, '\0');
+                scalar.hex_decode(digits.data(), nibbles, &expected_bytes[0],
+                                  high_first);
+                k->hex_decode(digits.data(), nibbles, &got_bytes[0],
+                              high_first);
+                EXPECT_EQ(got_bytes, expected_bytes)
+                    << PhPacker::isa_name(k->isa);
+            }
+        }
+    }
+    char out[2];
+    scalar.hex_decode("aF3", 3, out, true);
+    EXPECT_EQ(std::string(out, 2), "\xaf\x30");
+    scalar.hex_decode("aF3", 3, out, false);
+    EXPECT_EQ(std::string(out, 2), "\xfa\x03");
+}
+
+TEST(PhPackerDispatch, Float)
+{
+    const php_kernels &scalar = php_kernel_table(Isa::Scalar);
+    std::vector<double> doubles;
+    for (int i = 0; i < 77; ++i) {
+        doubles.push_back(std::ldexp(1.0 + i / 77.0, i * 9 - 300) *
+                          (i % 2 ? -1 : 1));
+    }
+    doubles.push_back(std::nan(""));
+    doubles.push_back(1e300);
+    const size_t n = doubles.size();
+    for (const php_kernels *k : supported_kernels()) {
+        std::vector<float> expected(n);
+        std::vector<float> got(n);
+        scalar.f64_to_f32(doubles.data(), n, expected.data());
+        k->f64_to_f32(doubles.data(), n, got.data());
+        EXPECT_EQ(memcmp(got.data(), expected.data(), n * sizeof(float)), 0)
+            << PhPacker::isa_name(k->isa);
+
+        std::vector<double> wide_expected(n);
+        std::vector<double> wide(n);
+        scalar.f32_to_f64(expected.data(), n, wide_expected.data());
+        k->f32_to_f64(expected.data(), n, wide.data());
+        EXPECT_EQ(memcmp(wide.data(), wide_expected.data(), n * sizeof(double)),
+                  0)
+            << PhPacker::isa_name(k->isa);
+    }
+}
+
+TEST(PhPackerDispatch, Crc32c)
+{
+    const php_kernels &scalar = php_kernel_table(Isa::Scalar);
+    const std::string src = bytes(1000);
+    for (const php_kernels *k : supported_kernels()) {
+        for (size_t n : {0u, 1u, 7u, 8u, 9u, 1000u}) {
+            EXPECT_EQ(k->crc32c(~0u, src.data(), n),
+                      scalar.crc32c(~0u, src.data(), n))
+                << k->crc32c_name;
+        }
+    }
+}
+
+TEST(PhPackerDispatch, Arrays)
+{
+    /* the whole array paths, against packing value by value */
+    std::vector<double> values;
+    for (int i = 0; i < 300; ++i) {
+        values.push_back(i * 1.25 - 100);
+    }
+    for (char code : {'g', 'G', 'f', 'e', 'E'}) {
+        const std::string packed =
+            PhPacker::pack_array(code, values.data(), values.size());
+        const size_t size =
+            PhPacker::__phpack__detail::php_pack_code_size(code);
+        for (size_t i = 0; i < values.size(); ++i) {
+            ASSERT_EQ(packed.substr(i * size, size),
+                      PhPacker::pack(code, values[i]))
+                << code << i;
+        }
+        std::vector<double> back(values.size());
+        PhPacker::unpack_array(code, packed.data(), back.size(), back.data());
+        EXPECT_EQ(back, values) << code;
+    }
+
+    std::vector<int16_t> shorts;
+    for (int i = 0; i < 300; ++i) {
+        shorts.push_back(static_cast<int16_t>(i * 397 - 30000));
+    }
+    const std::string packed =
+        PhPacker::pack_array('n', shorts.data(), shorts.size());
+    for (size_t i = 0; i < shorts.size(); ++i) {
+        ASSERT_EQ(packed.substr(i * 2, 2), PhPacker::pack('n', shorts[i]));
+    }
+    std::vector<int16_t> back(shorts.size());
+    PhPacker::unpack_array('n', packed.data(), back.size(), back.data());
+    EXPECT_EQ(back, shorts);
+}
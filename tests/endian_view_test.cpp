@@ -0,0 +1,77 @@
+#include "../include/endian_view.h"
+#include "../include/format.h"
+
+#include "gtest/gtest.h"
+#include <any>
+#include <string>
+
+namespace {
+
+struct Header {
+    PhPacker::be_u32 length;
+    PhPacker::be_u16 flags;
+    PhPacker::u8 kind;
+    PhPacker::le_u16 samples[2];
+    PhPacker::be_f64 value;
+};
+
+constexpr const char *header_format =
+    PhPacker::overlay_format<PhPacker::be_u32, PhPacker::be_u16, PhPacker::u8,
+                             PhPacker::le_u16, PhPacker::le_u16,
+                             PhPacker::be_f64>;
+
+static_assert(PhPacker::is_overlay_v<Header>);
+static_assert(sizeof(Header) == 19);
+
+} // namespace
+
+TEST(PhPackerEndianView, Format)
+{
+    EXPECT_STREQ(header_format, "NnCvvE");
+    EXPECT_EQ(PhPacker::Format(header_format).size(), sizeof(Header));
+    EXPECT_EQ(PhPacker::le_u32::code, 'V');
+    EXPECT_EQ(PhPacker::le_f32::code, 'g');
+    EXPECT_EQ(PhPacker::be_u64::code, 'J');
+    EXPECT_EQ(PhPacker::i8::code, 'c');
+}
+
+TEST(PhPackerEndianView, Read)
+{
+    const std::string data =
+        PhPacker::pack(header_format, 70000, 0xBEEF, 7, 1, 2, -2.5);
+    const Header *h = PhPacker::overlay<Header>(data.data());
+    EXPECT_EQ(h->length, 70000u);
+    EXPECT_EQ(h->flags, 0xBEEF);
+    EXPECT_EQ(h->kind, 7);
+    EXPECT_EQ(h->samples[0], 1);
+    EXPECT_EQ(h->samples[1], 2);
+    EXPECT_DOUBLE_EQ(h->value, -2.5);
+
+    /* at an odd offset */
+    const std::string records = "x" + data + data;
+    EXPECT_EQ(PhPacker::overlay<Header>(records.data() + 1 + sizeof(Header))
+                  ->length.get(),
+              70000u);
+    EXPECT_EQ(PhPacker::overlay<Header>(std::string_view(data), 0)->kind, 7);
+    EXPECT_THROW(PhPacker::overlay<Header>(std::string_view(data), 1),
+                 std::out_of_range);
+}
+
+TEST(PhPackerEndianView, Write)
+{
+    std::string data(sizeof(Header), '\0');
+    Header *h = PhPacker::overlay<Header>(&data[0]);
+    h->length = 5;
+    h->flags = 0x0102;
+    h->kind = 3;
+    h->samples[0] = 0x0a0b;
+    h->samples[1] = 0;
+    h->value = 1.0;
+    EXPECT_EQ(data, PhPacker::pack(header_format, 5, 0x0102, 3, 0x0a0b, 0, 1.0));
+
+    PhPacker::be_i32 negative = -7;
+    EXPECT_EQ(std::string(negative.data(), 4), std::string("\xff\xff\xff\xf9"));
+    EXPECT_EQ(negative, -7);
+    PhPacker::le_f32 f = 0.5f;
+    EXPECT_EQ(std::string(f.data(), 4), PhPacker::pack("g", 0.5f));
+}
@@ -0,0 +1,160 @@
+#include "../include/format.h"
+
+#include "gtest/gtest.h"
+#include <limits>
+#include <stdexcept>
+
+TEST(PhPackerFormat, Layout)
+{
+    PhPacker::Format format("nVC2");
+    ASSERT_EQ(format.fields().size(), 4u);
+    EXPECT_EQ(format.size(), 8u);
+    EXPECT_EQ(format.fields()[0].offset, 0u);
+    EXPECT_EQ(format.fields()[1].offset, 2u);
+    EXPECT_EQ(format.fields()[2].offset, 6u);
+    EXPECT_EQ(format.fields()[3].offset, 7u);
+    EXPECT_EQ(format.fields()[3].code, 'C');
+}
+
+TEST(PhPackerFormat, MatchesSingleCodePack)
+{
+    const std::string format = "cCsSnviIlLNVqQJPfgGdeE";
+    std::string expected;
+    for (char code : format) {
+        if (PhPacker::__phpack__detail::php_pack_code_is_float(code)) {
+            expected += PhPacker::pack(code, 1.5);
+        } else {
+            expected += PhPacker::pack(code, int64_t{0x1234});
+        }
+    }
+
+    std::string str = PhPacker::pack(format, 0x1234, 0x1234, 0x1234, 0x1234,
+                                     0x1234, 0x1234, 0x1234, 0x1234, 0x1234,
+                                     0x1234, 0x1234, 0x1234, 0x1234, 0x1234,
+                                     0x1234, 0x1234, 1.5, 1.5, 1.5, 1.5, 1.5,
+                                     1.5);
+    EXPECT_EQ(str, expected);
+}
+
+TEST(PhPackerFormat, RoundTrip)
+{
+    std::string str = PhPacker::pack("nVqEc", uint16_t{65535}, 655351234u,
+                                     std::numeric_limits<int64_t>::min(),
+                                     123.234, -77);
+    auto values = PhPacker::unpack("nVqEc", str);
+    ASSERT_EQ(values.size(), 5u);
+    EXPECT_EQ(std::any_cast<uint16_t>(values[0]), 65535);
+    EXPECT_EQ(std::any_cast<uint32_t>(values[1]), 655351234u);
+    EXPECT_EQ(std::any_cast<int64_t>(values[2]),
+              std::numeric_limits<int64_t>::min());
+    EXPECT_EQ(std::any_cast<double>(values[3]), 123.234);
+    EXPECT_EQ(std::any_cast<signed char>(values[4]), -77);
+}
+
+TEST(PhPackerFormat, Errors)
+{
+    EXPECT_THROW(PhPacker::Format("nY"), std::invalid_argument);
+    EXPECT_THROW(PhPacker::Format("C*"), std::invalid_argument);
+    EXPECT_THROW(PhPacker::pack("nn", 1), std::invalid_argument);
+    EXPECT_THROW(PhPacker::pack("n", 1, 2), std::invalid_argument);
+    EXPECT_THROW(PhPacker::unpack("N", std::string("ab")), std::out_of_range);
+}
+
+TEST(PhPackerFormat, Cache)
+{
+    PhPacker::FormatCache cache(2);
+    const PhPacker::Format &a = cache.get("nV");
+    EXPECT_EQ(a.size(), 6u);
+    EXPECT_EQ(&cache.get("nV"), &a);
+    EXPECT_EQ(cache.hits(), 1u);
+    EXPECT_EQ(cache.misses(), 1u);
+
+    cache.get("C");
+    cache.get("nV");
+    /* "C" is now the least recently used entry */
+    cache.get("J");
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_EQ(cache.misses(), 3u);
+    cache.get("nV");
+    EXPECT_EQ(cache.hits(), 3u);
+    cache.get("C");
+    EXPECT_EQ(cache.misses(), 4u);
+
+    EXPECT_THROW(cache.get("Y"), std::invalid_argument);
+    EXPECT_EQ(cache.size(), 2u);
+
+    cache.clear();
+    EXPECT_EQ(cache.size(), 0u);
+}
+
+TEST(PhPackerFormat, Strings)
+{
+    PhPacker::Format format("a4A4Z4h3H*xa*");
+    EXPECT_FALSE(format.fixed());
+    EXPECT_EQ(format.args(), 6u);
+
+    std::string str =
+        format.pack("ab", "cd", "efghij", "a1b", "beef0", std::string("tail"));
+    EXPECT_EQ(str, std::string("ab\0\0cd  efg\0\x1a\x0b\xbe\xef\x00\0tail", 22));
+
+    /* a '*' field unpacks the rest of the input */
+    auto values = PhPacker::Format("a4A4Z4h3H*").unpack(str);
+    ASSERT_EQ(values.size(), 5u);
+    EXPECT_EQ(std::any_cast<std::string>(values[0]), std::string("ab\0\0", 4));
+    EXPECT_EQ(std::any_cast<std::string>(values[1]), "cd");
+    EXPECT_EQ(std::any_cast<std::string>(values[2]), "efg");
+    EXPECT_EQ(std::any_cast<std::string>(values[3]), "a1b");
+    EXPECT_EQ(std::any_cast<std::string>(values[4]), "beef00007461696c");
+
+    EXPECT_THROW(format.pack(1, "cd", "ef", "a1", "be", "t"),
+                 std::invalid_argument);
+    EXPECT_THROW(format.pack("ab", "cd", "ef", "xy", "be", "t"),
+                 std::invalid_argument);
+    EXPECT_THROW(PhPacker::Format("nX"), std::invalid_argument);
+}
+
+TEST(PhPackerFormat, PackTo)
+{
+    const PhPacker::Format format("nB3B5a*");
+    char buf[16];
+    memset(buf, 0x55, sizeof(buf));
+    EXPECT_EQ(format.packed_size(1, 5, 9, std::string_view("abc")), 6);
+    const size_t n =
+        format.pack_to(buf, sizeof(buf), 1, 5, 9, std::string_view("abc"));
+    EXPECT_EQ(std::string(buf, n),
+              format.pack(1, 5, 9, std::string_view("abc")));
+    EXPECT_THROW(format.pack_to(buf, 5, 1, 5, 9, std::string_view("abc")),
+                 std::length_error);
+}
+
+TEST(PhPackerFormat, Conversion)
+{
+    using PhPacker::Conversion;
+    const PhPacker::Format wrap("nCcB4");
+    const PhPacker::Format check("nCcB4", Conversion::Check);
+    const PhPacker::Format saturate("nCcB4", Conversion::Saturate);
+    EXPECT_EQ(check.conversion(), Conversion::Check);
+
+    EXPECT_EQ(check.pack(65535, 255, -128, 15), wrap.pack(65535, 255, -128, 15));
+    try {
+        check.pack(1, 2, -129, 0);
+        FAIL() << "expected a RangeError";
+    } catch (const PhPacker::RangeError &e) {
+        EXPECT_EQ(e.index(), 2);
+        EXPECT_EQ(e.code(), 'c');
+    }
+    EXPECT_THROW(check.pack(70000, 0, 0, 0), PhPacker::RangeError);
+    EXPECT_THROW(check.pack(0, -1, 0, 0), PhPacker::RangeError);
+    EXPECT_THROW(check.pack(0, 0, 0, 16), PhPacker::RangeError);
+    EXPECT_THROW(check.pack(0, 256.0, 0, 0), PhPacker::RangeError);
+
+    EXPECT_EQ(saturate.pack(70000, -5, 1000, 99),
+              wrap.pack(65535, 0, 127, 15));
+    EXPECT_EQ(saturate.pack(uint64_t{1} << 63, 3.5, -1e30, 3),
+              wrap.pack(65535, 3, -128, 3));
+
+    const PhPacker::Format floats("gq", Conversion::Saturate);
+    EXPECT_EQ(floats.pack(-1e300, 1e300),
+              PhPacker::Format("gq").pack(-std::numeric_limits<float>::max(),
+                                          std::numeric_limits<int64_t>::max()));
+}
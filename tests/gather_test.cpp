@@ -0,0 +1,100 @@
+#include "../include/gather.h"
+
+#include "gtest/gtest.h"
+#include <string>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+TEST(PhPackerGather, SameBytesAsPack)
+{
+    const std::string payload(1000, 'p');
+    const std::string shorter(300, 's');
+    PhPacker::Format format("Nna*A400Z5H4xa3Z*");
+
+    PhPacker::GatherOutput output(256);
+    PhPacker::pack_gather(output, format, 655351234u, 1, payload, shorter,
+                          "abcdefg", "beef", "ab", payload);
+
+    const std::string expected = format.pack(655351234u, 1, payload, shorter,
+                                             "abcdefg", "beef", "ab", payload);
+    EXPECT_EQ(output.size(), expected.size());
+    EXPECT_EQ(output.str(), expected);
+
+    /* long strings are referenced, not copied */
+    const auto &iov = output.iov();
+    ASSERT_EQ(iov.size(), 6u);
+    EXPECT_EQ(iov[1].iov_base, payload.data());
+    EXPECT_EQ(iov[1].iov_len, payload.size());
+    EXPECT_EQ(iov[2].iov_base, shorter.data());
+    EXPECT_EQ(iov[2].iov_len, shorter.size());
+    EXPECT_EQ(iov[4].iov_base, payload.data());
+
+    std::string joined;
+    for (const auto &v : iov) {
+        joined.append(static_cast<const char *>(v.iov_base), v.iov_len);
+    }
+    EXPECT_EQ(joined, expected);
+}
+
+TEST(PhPackerGather, Records)
+{
+    const std::string payload(512, 'x');
+    PhPacker::Format format("na*");
+    PhPacker::GatherOutput output;
+    std::string expected;
+    for (int i = 0; i < 3; ++i) {
+        PhPacker::pack_gather(output, format, i, payload);
+        expected += format.pack(i, payload);
+    }
+    EXPECT_EQ(output.str(), expected);
+    EXPECT_EQ(output.iov().size(), 6u);
+
+    output.clear();
+    EXPECT_EQ(output.size(), 0u);
+    EXPECT_TRUE(output.iov().empty());
+
+    /* only the 5 packed bytes count towards the threshold */
+    PhPacker::Format fixed("na5");
+    PhPacker::pack_gather(output, fixed, 1, payload);
+    EXPECT_EQ(output.str(), fixed.pack(1, payload));
+    EXPECT_EQ(output.iov().size(), 1u);
+}
+
+#ifndef _WIN32
+TEST(PhPackerGather, Saturate)
+{
+    const PhPacker::Format format("nB3a*", PhPacker::Conversion::Saturate);
+    const std::string payload(300, 'p');
+    PhPacker::GatherOutput output;
+    PhPacker::pack_gather(output, format, 70000, 9, payload);
+    EXPECT_EQ(output.str(), format.pack(70000, 9, payload));
+    EXPECT_EQ(output.str(), PhPacker::Format("nB3a*").pack(65535, 7, payload));
+}
+
+TEST(PhPackerGather, Writev)
+{
+    const std::string payload(4096, 'w');
+    PhPacker::GatherOutput output;
+    PhPacker::pack_gather(output, PhPacker::Format("Na*"), 4096u, payload);
+
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    const auto &iov = output.iov();
+    const ssize_t written = writev(fds[1], iov.data(),
+                                   static_cast<int>(iov.size()));
+    ASSERT_EQ(written, static_cast<ssize_t>(output.size()));
+    close(fds[1]);
+
+    std::string read_back(output.size(), '\0');
+    size_t got = 0;
+    while (got < read_back.size()) {
+        const ssize_t n = read(fds[0], &read_back[got], read_back.size() - got);
+        ASSERT_GT(n, 0);
+        got += static_cast<size_t>(n);
+    }
+    close(fds[0]);
+    EXPECT_EQ(read_back, output.str());
+}
+#endif
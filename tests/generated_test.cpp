@@ -0,0 +1,103 @@
+#include "../include/format.h"
+#include "records.h"
+
+#include "gtest/gtest.h"
+#include <any>
+#include <limits>
+#include <vector>
+
+namespace {
+
+/* a decoded member against the value Format::unpack() yields for it */
+template <typename T, typename U> void expect_value(const std::any &v, U member)
+{
+    EXPECT_EQ(std::any_cast<T>(v), static_cast<T>(member));
+}
+
+} // namespace
+
+TEST(PhPackerGenerated, Header)
+{
+    phpack_test::Header header{655351234u, 65535, 200, {1, 2, 3, 65535}};
+    std::string str = phpack_test::encode(header);
+    ASSERT_EQ(str.size(), phpack_test::Header::packed_size);
+
+    PhPacker::Format format(phpack_test::Header::format);
+    EXPECT_EQ(format.size(), phpack_test::Header::packed_size);
+    EXPECT_EQ(str, format.pack(header.length, header.flags, header.kind,
+                               header.samples[0], header.samples[1],
+                               header.samples[2], header.samples[3]));
+
+    phpack_test::Header decoded{};
+    phpack_test::decode(str.data(), decoded);
+    EXPECT_EQ(decoded.length, header.length);
+    EXPECT_EQ(decoded.flags, header.flags);
+    EXPECT_EQ(decoded.kind, header.kind);
+    EXPECT_EQ(decoded.samples, header.samples);
+
+    const std::vector<std::any> values = format.unpack(str);
+    ASSERT_EQ(values.size(), 7u);
+    expect_value<uint32_t>(values[0], decoded.length);
+    expect_value<unsigned short>(values[1], decoded.flags);
+    expect_value<unsigned char>(values[2], decoded.kind);
+    for (size_t i = 0; i < 4; ++i) {
+        expect_value<unsigned short>(values[3 + i], decoded.samples[i]);
+    }
+}
+
+TEST(PhPackerGenerated, Reading)
+{
+    phpack_test::Reading r{-77,
+                           -1234,
+                           65535,
+                           std::numeric_limits<int>::min(),
+                           655351234u,
+                           std::numeric_limits<int32_t>::min(),
+                           std::numeric_limits<uint32_t>::max(),
+                           123,
+                           std::numeric_limits<int64_t>::min(),
+                           65535123424ull,
+                           std::numeric_limits<uint64_t>::max(),
+                           65ull,
+                           1.234f,
+                           65232.123f,
+                           -0.5f,
+                           123.234,
+                           652322.123,
+                           65232213123.123};
+    std::string str = phpack_test::encode(r);
+
+    PhPacker::Format format(phpack_test::Reading::format);
+    EXPECT_EQ(str, format.pack(r.sensor, r.raw, r.count, r.id, r.total,
+                               r.delta, r.mask, r.seq, r.offset, r.epoch,
+                               r.stamp, r.serial, r.value, r.gain, r.scale,
+                               r.mean, r.low, r.high));
+
+    phpack_test::Reading decoded{};
+    phpack_test::decode(str.data(), decoded);
+    EXPECT_EQ(phpack_test::encode(decoded), str);
+    EXPECT_EQ(decoded.offset, r.offset);
+    EXPECT_EQ(decoded.scale, r.scale);
+    EXPECT_EQ(decoded.high, r.high);
+
+    const std::vector<std::any> values = format.unpack(str);
+    ASSERT_EQ(values.size(), 18u);
+    expect_value<signed char>(values[0], decoded.sensor);
+    expect_value<short>(values[1], decoded.raw);
+    expect_value<unsigned short>(values[2], decoded.count);
+    expect_value<int>(values[3], decoded.id);
+    expect_value<unsigned int>(values[4], decoded.total);
+    expect_value<int32_t>(values[5], decoded.delta);
+    expect_value<uint32_t>(values[6], decoded.mask);
+    expect_value<uint32_t>(values[7], decoded.seq);
+    expect_value<int64_t>(values[8], decoded.offset);
+    expect_value<uint64_t>(values[9], decoded.epoch);
+    expect_value<uint64_t>(values[10], decoded.stamp);
+    expect_value<uint64_t>(values[11], decoded.serial);
+    expect_value<float>(values[12], decoded.value);
+    expect_value<float>(values[13], decoded.gain);
+    expect_value<float>(values[14], decoded.scale);
+    expect_value<double>(values[15], decoded.mean);
+    expect_value<double>(values[16], decoded.low);
+    expect_value<double>(values[17], decoded.high);
+}
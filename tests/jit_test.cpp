@@ -0,0 +1,264 @@
+#include "../include/jit.h"
+
+#include "gtest/gtest.h"
+#include <any>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using PhPacker::Format;
+using PhPacker::FormatField;
+using PhPacker::JitFormat;
+
+bool is_float(char code) { return code == 'f' || code == 'g' || code == 'G'; }
+
+bool is_double(char code)
+{
+    return code == 'd' || code == 'e' || code == 'E';
+}
+
+/* numeric codes and padding, with repeat counts */
+std::string random_format(std::mt19937_64 &rng)
+{
+    const std::string codes = "cCsSnviIlLNVqQJPfgGdeEx";
+    std::string format;
+    const size_t fields = 1 + rng() % 40;
+    for (size_t i = 0; i < fields; ++i) {
+        format += codes[rng() % codes.size()];
+        if (rng() % 4 == 0) {
+            format += std::to_string(1 + rng() % 5);
+        }
+    }
+    return format;
+}
+
+/* a slot per value, floats as the bits of finite values */
+std::vector<uint64_t> random_slots(const Format &format, std::mt19937_64 &rng)
+{
+    std::vector<uint64_t> slots;
+    for (const FormatField &field : format.fields()) {
+        if (!field.takes_value()) {
+            continue;
+        }
+        uint64_t v = rng();
+        if (is_float(field.code)) {
+            const auto f = static_cast<float>(static_cast<int64_t>(v) >> 20) /
+                           1024.0f;
+            uint32_t bits{};
+            memcpy(&bits, &f, sizeof(float));
+            v = bits;
+        } else if (is_double(field.code)) {
+            const double d = static_cast<double>(static_cast<int64_t>(v)) /
+                             65536.0;
+            memcpy(&v, &d, sizeof(double));
+        }
+        slots.push_back(v);
+    }
+    return slots;
+}
+
+/* what Format packs for the slots, one field at a time */
+std::string interpret(const Format &format, const std::vector<uint64_t> &slots)
+{
+    using namespace PhPacker::__phpack__detail;
+    std::string out(format.size(), '\0');
+    size_t s = 0;
+    for (const FormatField &field : format.fields()) {
+        if (!field.takes_value()) {
+            continue;
+        }
+        const uint64_t v = slots[s++];
+        if (is_float(field.code)) {
+            const auto bits = static_cast<uint32_t>(v);
+            float f{};
+            memcpy(&f, &bits, sizeof(float));
+            field.store(php_make_pack_arg(static_cast<double>(f)),
+                        &out[field.offset]);
+        } else if (is_double(field.code)) {
+            double d{};
+            memcpy(&d, &v, sizeof(double));
+            field.store(php_make_pack_arg(d), &out[field.offset]);
+        } else {
+            field.store(php_make_pack_arg(v), &out[field.offset]);
+        }
+    }
+    return out;
+}
+
+template <typename T> bool same_as(const std::any &a, const std::any &b)
+{
+    return std::any_cast<T>(a) == std::any_cast<T>(b);
+}
+
+bool same_value(const std::any &a, const std::any &b)
+{
+    if (a.type() != b.type()) {
+        return false;
+    }
+    if (a.type() == typeid(float)) {
+        return same_as<float>(a, b);
+    }
+    if (a.type() == typeid(double)) {
+        return same_as<double>(a, b);
+    }
+    if (a.type() == typeid(signed char)) {
+        return same_as<signed char>(a, b);
+    }
+    if (a.type() == typeid(unsigned char)) {
+        return same_as<unsigned char>(a, b);
+    }
+    if (a.type() == typeid(short)) {
+        return same_as<short>(a, b);
+    }
+    if (a.type() == typeid(unsigned short)) {
+        return same_as<unsigned short>(a, b);
+    }
+    if (a.type() == typeid(int)) {
+        return same_as<int>(a, b);
+    }
+    if (a.type() == typeid(unsigned int)) {
+        return same_as<unsigned int>(a, b);
+    }
+    if (a.type() == typeid(int64_t)) {
+        return same_as<int64_t>(a, b);
+    }
+    return same_as<uint64_t>(a, b);
+}
+
+/* native code for both byte swap forms, movbe only where the CPU has it,
+ * whatever kernel_isa() picked for this process */
+std::vector<std::unique_ptr<PhPacker::__phpack__detail::php_jit_code>>
+compile_all(const Format &format)
+{
+    using PhPacker::__phpack__detail::php_jit_code;
+    std::vector<std::unique_ptr<php_jit_code>> code;
+#ifdef PHPACK_JIT
+    code.push_back(php_jit_code::compile(format, false));
+    if (PhPacker::__phpack__detail::php_cpu_movbe()) {
+        code.push_back(php_jit_code::compile(format, true));
+    }
+#else
+    (void)format;
+#endif
+    return code;
+}
+
+} // namespace
+
+TEST(PhPackerJit, Native)
+{
+    const JitFormat jit(Format("NvxE"));
+#ifdef PHPACK_JIT
+    EXPECT_TRUE(jit.native());
+#else
+    EXPECT_FALSE(jit.native());
+#endif
+    EXPECT_FALSE(JitFormat(Format("NvxE"), false).native());
+    EXPECT_EQ(jit.size(), 15u);
+    EXPECT_EQ(jit.slots(), 3u);
+}
+
+TEST(PhPackerJit, Differential)
+{
+    std::mt19937_64 rng(20260419);
+    for (int round = 0; round < 500; ++round) {
+        const Format format(random_format(rng));
+        const JitFormat native(format);
+        const JitFormat interpreter(format, false);
+        ASSERT_EQ(native.slots(), format.args());
+        const std::vector<uint64_t> slots = random_slots(format, rng);
+        const std::string expected = interpret(format, slots);
+
+        /* garbage in out, padding must still come out as NUL */
+        std::string a(format.size(), '\xa5');
+        std::string b(format.size(), '\x5a');
+        native.encode(slots.data(), &a[0]);
+        interpreter.encode(slots.data(), &b[0]);
+        ASSERT_EQ(a, expected) << format.str();
+        ASSERT_EQ(b, expected) << format.str();
+
+        std::vector<uint64_t> decoded(slots.size());
+        std::vector<uint64_t> reference(slots.size());
+        native.decode(expected.data(), decoded.data());
+        interpreter.decode(expected.data(), reference.data());
+        ASSERT_EQ(decoded, reference) << format.str();
+
+        for (const auto &code : compile_all(format)) {
+            ASSERT_TRUE(code);
+            std::string c(format.size(), '\xa5');
+            code->encode()(slots.data(), &c[0]);
+            ASSERT_EQ(c, expected) << format.str();
+            std::vector<uint64_t> d(slots.size());
+            code->decode()(expected.data(), d.data());
+            ASSERT_EQ(d, reference) << format.str();
+        }
+
+        const std::vector<std::any> values = format.unpack(expected);
+        const std::vector<std::any> jitted = native.unpack(expected);
+        ASSERT_EQ(jitted.size(), values.size());
+        for (size_t i = 0; i < values.size(); ++i) {
+            ASSERT_TRUE(same_value(jitted[i], values[i]))
+                << format.str() << " value " << i;
+        }
+    }
+}
+
+TEST(PhPackerJit, SignExtension)
+{
+    const Format format("csil");
+    const JitFormat native(format);
+    const JitFormat interpreter(format, false);
+    const std::string data = format.pack(-1, -2, -3, -4);
+    uint64_t a[4];
+    uint64_t b[4];
+    native.decode(data.data(), a);
+    interpreter.decode(data.data(), b);
+    for (size_t i = 0; i < 4; ++i) {
+        EXPECT_EQ(static_cast<int64_t>(a[i]), -static_cast<int64_t>(i + 1));
+        EXPECT_EQ(a[i], b[i]);
+    }
+    for (const auto &code : compile_all(format)) {
+        uint64_t c[4];
+        code->decode()(data.data(), c);
+        for (size_t i = 0; i < 4; ++i) {
+            EXPECT_EQ(c[i], b[i]);
+        }
+    }
+}
+
+TEST(PhPackerJit, Pack)
+{
+    const Format format("nVcx2qgE");
+    const JitFormat jit(format);
+    EXPECT_EQ(jit.pack(70000, 0xdeadbeefu, -5, -1ll, 1.5f, -2.25),
+              format.pack(70000, 0xdeadbeefu, -5, -1ll, 1.5f, -2.25));
+
+    const Format saturate("nc", PhPacker::Conversion::Saturate);
+    EXPECT_EQ(JitFormat(saturate).pack(70000, -500),
+              saturate.pack(70000, -500));
+
+    const Format check("Cn", PhPacker::Conversion::Check);
+    try {
+        JitFormat(check).pack(1, 70000);
+        FAIL() << "expected RangeError";
+    } catch (const PhPacker::RangeError &e) {
+        EXPECT_EQ(e.code(), 'n');
+        EXPECT_EQ(e.index(), 1u);
+    }
+    EXPECT_THROW(jit.pack(1, 2), std::invalid_argument);
+}
+
+TEST(PhPackerJit, Errors)
+{
+    EXPECT_THROW(JitFormat(Format("Na4")), std::invalid_argument);
+    EXPECT_THROW(JitFormat(Format("NH4")), std::invalid_argument);
+    EXPECT_THROW(JitFormat(Format("b3b5")), std::invalid_argument);
+    EXPECT_THROW(JitFormat(Format("Na*")), std::invalid_argument);
+
+    const JitFormat jit(Format("NN"));
+    EXPECT_THROW(jit.unpack(std::string(7, '\0')), std::out_of_range);
+}
@@ -0,0 +1,145 @@
+#include "../include/pack_ring.h"
+
+#include "gtest/gtest.h"
+#include <any>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(PhPackerPackRing, Order)
+{
+    const PhPacker::Format format("Nna*");
+    PhPacker::PackRing ring(3, 16);
+    EXPECT_EQ(ring.slots(), 4);
+
+    for (uint32_t i = 0; i < 4; ++i) {
+        EXPECT_TRUE(ring.try_pack(format, i, 7, std::string_view("ab")));
+    }
+    EXPECT_FALSE(ring.try_pack(format, 4, 7, std::string_view("ab")));
+    EXPECT_THROW(ring.try_pack(format, 4, 7, std::string(20, 'x')),
+                 std::length_error);
+
+    std::vector<uint32_t> seen;
+    EXPECT_EQ(ring.drain(
+                  [&](std::string_view record) {
+                      EXPECT_EQ(record.size(), 8);
+                      seen.push_back(std::any_cast<uint32_t>(
+                          format.unpack(record)[0]));
+                  },
+                  3),
+              3);
+    EXPECT_EQ(seen, (std::vector<uint32_t>{0, 1, 2}));
+
+    /* a reservation blocks everything after it until it is committed */
+    auto r = ring.try_reserve();
+    ASSERT_TRUE(r);
+    EXPECT_TRUE(ring.try_pack(format, 5, 7, std::string_view()));
+    EXPECT_EQ(ring.drain([&](std::string_view) {}), 1);
+    ring.commit(r, 0);
+    seen.clear();
+    EXPECT_EQ(ring.drain([&](std::string_view record) {
+                  seen.push_back(
+                      std::any_cast<uint32_t>(format.unpack(record)[0]));
+              }),
+              2);
+    EXPECT_EQ(seen, (std::vector<uint32_t>{5}));
+}
+
+TEST(PhPackerPackRing, Producers)
+{
+    const PhPacker::Format format("NN");
+    PhPacker::PackRing ring(64, 8);
+    const uint32_t producers = 8;
+    const uint32_t records = 5000;
+
+    std::vector<std::thread> threads;
+    for (uint32_t p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            for (uint32_t i = 0; i < records; ++i) {
+                ring.pack(format, p, i);
+            }
+        });
+    }
+
+    std::vector<uint32_t> next(producers, 0);
+    size_t total = 0;
+    bool ordered = true;
+    while (total < producers * records) {
+        const size_t n = ring.drain([&](std::string_view record) {
+            const auto values = format.unpack(record);
+            const auto p = std::any_cast<uint32_t>(values[0]);
+            ordered = ordered && std::any_cast<uint32_t>(values[1]) == next[p];
+            ++next[p];
+        });
+        if (n == 0) {
+            std::this_thread::yield();
+        }
+        total += n;
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    EXPECT_TRUE(ordered);
+    EXPECT_EQ(next, std::vector<uint32_t>(producers, records));
+    EXPECT_EQ(ring.drain([](std::string_view) {}), 0);
+}
+
+TEST(PhPackerPackRing, OneSlot)
+{
+    /* a single slot would be free again as soon as it is committed */
+    const PhPacker::Format format("N");
+    PhPacker::PackRing ring(1, 4);
+    EXPECT_EQ(ring.slots(), 2);
+
+    for (uint32_t lap = 0; lap < 3; ++lap) {
+        EXPECT_TRUE(ring.try_pack(format, 2 * lap));
+        EXPECT_TRUE(ring.try_pack(format, 2 * lap + 1));
+        EXPECT_FALSE(ring.try_pack(format, 99u));
+        std::vector<uint32_t> seen;
+        EXPECT_EQ(ring.drain([&](std::string_view record) {
+                      seen.push_back(
+                          std::any_cast<uint32_t>(format.unpack(record)[0]));
+                  }),
+                  2);
+        EXPECT_EQ(seen, (std::vector<uint32_t>{2 * lap, 2 * lap + 1}));
+    }
+}
+
+TEST(PhPackerPackRing, Runs)
+{
+    /* records fill their slots, so a run is the records back to back */
+    const PhPacker::Format format("n");
+    PhPacker::PackRing ring(8, format.size());
+
+    for (uint16_t i = 0; i < 5; ++i) {
+        ring.pack(format, i);
+    }
+    EXPECT_EQ(ring.drain([](std::string_view) {}), 5);
+    for (uint16_t i = 5; i < 11; ++i) {
+        ring.pack(format, i);
+    }
+    /* 5 to 7 up to the wrap, then 8 to 10 up to the reserved slot */
+    auto r = ring.try_reserve();
+    ASSERT_TRUE(r);
+    EXPECT_TRUE(ring.try_pack(format, 12));
+
+    std::vector<std::string> runs;
+    EXPECT_EQ(ring.drain_runs([&](const PhPacker::PackRing::Run &run) {
+                  EXPECT_EQ(run[run.size() - 1].size(), 2);
+                  runs.emplace_back(run.bytes());
+              }),
+              6);
+    ASSERT_EQ(runs.size(), 2);
+    EXPECT_EQ(runs[0], PhPacker::pack("nnn", 5, 6, 7));
+    EXPECT_EQ(runs[1], PhPacker::pack("nnn", 8, 9, 10));
+
+    ring.commit(r, 0);
+    EXPECT_EQ(ring.drain_runs([&](const PhPacker::PackRing::Run &run) {
+                  ASSERT_EQ(run.size(), 2);
+                  EXPECT_TRUE(run[0].empty());
+                  EXPECT_EQ(run[1], PhPacker::pack("n", 12));
+              }),
+              2);
+}
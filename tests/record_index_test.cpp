@@ -0,0 +1,133 @@
+#include "../include/record_index.h"
+#include "../include/delta.h"
+#include "../include/format.h"
+
+#include "gtest/gtest.h"
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+/* n records "Na*" with payloads of 0 to 9 bytes */
+std::string length_prefixed(size_t n, std::vector<size_t> &offsets)
+{
+    std::string file;
+    for (size_t i = 0; i < n; ++i) {
+        offsets.push_back(file.size());
+        file += PhPacker::pack("N", static_cast<uint32_t>(i % 10));
+        file += std::string(i % 10, static_cast<char>('a' + i % 26));
+    }
+    return file;
+}
+
+} // namespace
+
+TEST(PhPackerRecordIndex, Seek)
+{
+    std::vector<size_t> offsets;
+    const std::string file = length_prefixed(1000, offsets);
+    const auto index = PhPacker::RecordIndex::build(file, 'N', 64);
+
+    EXPECT_EQ(index.records(), 1000);
+    EXPECT_EQ(index.file_size(), file.size());
+    EXPECT_EQ(index.samples().size(), 16);
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        EXPECT_EQ(index.offset(i, file), offsets[i]) << "record " << i;
+    }
+    EXPECT_THROW(index.offset(1000, file), std::out_of_range);
+}
+
+TEST(PhPackerRecordIndex, Serialize)
+{
+    std::vector<size_t> offsets;
+    const std::string file = length_prefixed(5000, offsets);
+    const auto index = PhPacker::RecordIndex::build(file, 'N', 100);
+    const std::string sidecar = index.serialize();
+    /* varint deltas, not 8 bytes per sample */
+    EXPECT_LT(sidecar.size(), 50 * 4);
+
+    const auto loaded = PhPacker::RecordIndex::deserialize(sidecar);
+    EXPECT_EQ(loaded.records(), index.records());
+    EXPECT_EQ(loaded.every(), index.every());
+    EXPECT_EQ(loaded.file_size(), index.file_size());
+    EXPECT_EQ(loaded.samples(), index.samples());
+    EXPECT_EQ(loaded.offset(4321, file), offsets[4321]);
+
+    EXPECT_THROW(PhPacker::RecordIndex::deserialize("nope"),
+                 std::invalid_argument);
+    EXPECT_THROW(PhPacker::RecordIndex::deserialize(sidecar.substr(0, 30)),
+                 std::invalid_argument);
+
+    /* sample counts the remaining bytes can't hold, and counts that
+     * overflow records + every - 1 */
+    const uint64_t huge = uint64_t{1} << 62;
+    const uint64_t max = ~uint64_t{0};
+    EXPECT_THROW(PhPacker::RecordIndex::deserialize(PhPacker::pack(
+                     "a4PPPCP", "PXI1", 1, huge, 0, 'N', huge)),
+                 std::invalid_argument);
+    EXPECT_THROW(PhPacker::RecordIndex::deserialize(
+                     PhPacker::pack("a4PPPCP", "PXI1", max, max, 0, 'N', 1)),
+                 std::invalid_argument);
+
+    /* samples that are out of order, don't start at 0 or leave the file */
+    const std::string header =
+        PhPacker::pack("a4PPPCP", "PXI1", 2, 10, 80, 'N', 5);
+    const std::vector<std::vector<int64_t>> corrupt = {
+        {0, 60, 16, 70, 4}, {0, 16, 16, 60, 70}, {4, 16, 32, 60, 70},
+        {0, 16, 32, 60, 80}};
+    for (const auto &samples : corrupt) {
+        EXPECT_THROW(PhPacker::RecordIndex::deserialize(
+                         header + PhPacker::pack_delta(samples.data(), 5)),
+                     std::invalid_argument);
+    }
+    const std::vector<int64_t> good = {0, 16, 32, 60, 70};
+    EXPECT_NO_THROW(PhPacker::RecordIndex::deserialize(
+        header + PhPacker::pack_delta(good.data(), 5)));
+}
+
+TEST(PhPackerRecordIndex, SizeFunction)
+{
+    /* records end with a NUL byte */
+    const std::string file("one\0three\0\0seven\0", 17);
+    auto size = [](std::string_view data) {
+        const size_t end = data.find('\0');
+        return end == std::string_view::npos ? 0 : end + 1;
+    };
+    const auto index = PhPacker::RecordIndex::build(file, size, 2);
+    EXPECT_EQ(index.records(), 4);
+    EXPECT_EQ(index.offset(1, file, size), 4);
+    EXPECT_EQ(index.offset(3, file, size), 11);
+    EXPECT_THROW(index.offset(1, file), std::invalid_argument);
+
+    EXPECT_THROW(PhPacker::RecordIndex::build(file.substr(0, 16), size),
+                 std::out_of_range);
+    EXPECT_THROW(PhPacker::RecordIndex::build(file, 'a'),
+                 std::invalid_argument);
+}
+
+TEST(PhPackerRecordIndex, Split)
+{
+    std::vector<size_t> offsets;
+    const std::string file = length_prefixed(10000, offsets);
+    const auto index = PhPacker::RecordIndex::build(file, 'N', 128);
+
+    const auto ranges = index.split(4);
+    ASSERT_EQ(ranges.size(), 4);
+    size_t records = 0;
+    size_t offset = 0;
+    for (const auto &range : ranges) {
+        EXPECT_EQ(range.first, records);
+        EXPECT_EQ(range.offset, offset);
+        EXPECT_EQ(range.offset, offsets[range.first]);
+        EXPECT_NEAR(static_cast<double>(range.size),
+                    static_cast<double>(file.size()) / 4, 128 * 13);
+        records += range.records;
+        offset += range.size;
+    }
+    EXPECT_EQ(records, 10000);
+    EXPECT_EQ(offset, file.size());
+
+    /* no more parts than samples */
+    EXPECT_EQ(index.split(1000).size(), index.samples().size());
+}
@@ -0,0 +1,113 @@
+#include "../include/record_view.h"
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string records(size_t n)
+{
+    const PhPacker::Format format("NnxB3B5a4");
+    std::string data;
+    for (size_t i = 0; i < n; ++i) {
+        data += format.pack(static_cast<uint32_t>(i), i % 7, i % 8, i % 32,
+                            std::string_view("ab"));
+    }
+    return data;
+}
+
+} // namespace
+
+TEST(PhPackerRecordView, Format)
+{
+    const PhPacker::Format format("NnxB3B5a4");
+    const PhPacker::RecordLayout layout(format);
+    ASSERT_EQ(layout.fields().size(), 5);
+    EXPECT_EQ(layout.size(), 12);
+    EXPECT_TRUE(layout.fixed());
+
+    const std::string data = records(3);
+    const PhPacker::RecordView view(layout, std::string_view(data).substr(12));
+    const auto unpacked = format.unpack(view.data());
+    for (size_t i = 0; i < view.size(); ++i) {
+        EXPECT_EQ(view[i].type(), unpacked[i].type()) << i;
+    }
+    EXPECT_EQ(view.get<uint32_t>(0), 1);
+    EXPECT_EQ(view.get<int>(1), 1);
+    EXPECT_EQ(view.get<unsigned>(2), 1);
+    EXPECT_EQ(view.get<uint64_t>(3), 1);
+    EXPECT_EQ(view.get<std::string>(4), std::string("ab\0\0", 4));
+    EXPECT_EQ(view.get<std::string_view>(0), std::string_view("\0\0\0\1", 4));
+    EXPECT_EQ(view.get<uint32_t>("1"), 1);
+
+    EXPECT_THROW(view.get<int>(5), std::out_of_range);
+    EXPECT_THROW(view.get<int>(4), std::bad_any_cast);
+    EXPECT_THROW(view.get<std::string>(0), std::bad_any_cast);
+
+    const PhPacker::RecordView short_view(layout, std::string_view(data).substr(0, 6));
+    EXPECT_EQ(short_view.get<int>(1), 0);
+    EXPECT_THROW(short_view.get<int>(4), std::out_of_range);
+}
+
+TEST(PhPackerRecordView, Names)
+{
+    const PhPacker::RecordLayout layout("Nid/nkind/X2/Ckind_high/@8/a4tag");
+    EXPECT_EQ(layout.size(), 12);
+    const std::string data =
+        PhPacker::pack("Nnxxa4", 42, 0x0102, std::string_view("tag!"));
+    const PhPacker::RecordView view(layout, data);
+    EXPECT_EQ(view.get<uint32_t>("id"), 42);
+    EXPECT_EQ(view.get<int>("kind"), 0x0102);
+    EXPECT_EQ(view.get<int>("kind_high"), 1);
+    EXPECT_EQ(view.get<std::string>("tag"), "tag!");
+    EXPECT_THROW(view.get<int>("nope"), std::out_of_range);
+
+    const PhPacker::RecordLayout tail("nlen/a*body");
+    EXPECT_FALSE(tail.fixed());
+    const std::string message = PhPacker::pack("na*", 5, std::string_view("hello"));
+    EXPECT_EQ(PhPacker::RecordView(tail, message).get<std::string>("body"),
+              "hello");
+
+    EXPECT_THROW(PhPacker::RecordLayout("C*"), std::invalid_argument);
+    EXPECT_THROW(PhPacker::RecordLayout("a*/C"), std::invalid_argument);
+}
+
+TEST(PhPackerRecordView, Range)
+{
+    const PhPacker::RecordLayout layout(PhPacker::Format("NnxB3B5a4"));
+    const std::string data = records(100) + "part";
+    const PhPacker::RecordRange range(layout, data);
+    EXPECT_EQ(range.size(), 100);
+    EXPECT_EQ(range[42].get<uint32_t>(0), 42);
+    EXPECT_EQ(range.end() - range.begin(), 100);
+
+    const auto sevens =
+        std::count_if(range.begin(), range.end(), [](const PhPacker::RecordView &r) {
+            return r.get<int>(1) == 6;
+        });
+    EXPECT_EQ(sevens, 14);
+
+    std::vector<uint32_t> ids;
+    for (const auto &r : range) {
+        if (r.get<int>(2) == 3) {
+            ids.push_back(r.get<uint32_t>(0));
+        }
+    }
+    EXPECT_EQ(ids.size(), 13);
+    EXPECT_EQ(ids[1], 11);
+
+#if __cplusplus >= 202002L && defined(__cpp_lib_ranges)
+    auto filtered = range | std::views::filter([](const PhPacker::RecordView &r) {
+                        return r.get<int>(2) == 3;
+                    }) |
+                    std::views::transform([](const PhPacker::RecordView &r) {
+                        return r.get<uint32_t>(0);
+                    });
+    EXPECT_EQ(std::vector<uint32_t>(filtered.begin(), filtered.end()), ids);
+#endif
+
+    EXPECT_THROW(PhPacker::RecordRange(PhPacker::RecordLayout("nlen/a*body"), data),
+                 std::invalid_argument);
+}
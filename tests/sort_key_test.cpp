@@ -0,0 +1,124 @@
+#include "../include/sort_key.h"
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+template <typename T> void check_order(char code, std::vector<T> values)
+{
+    std::sort(values.begin(), values.end());
+    const size_t size = PhPacker::__phpack__detail::php_pack_code_size(code);
+    const std::string keys =
+        PhPacker::encode_keys(code, values.data(), values.size());
+    ASSERT_EQ(keys.size(), values.size() * size);
+
+    for (size_t i = 0; i < values.size(); ++i) {
+        const std::string key = keys.substr(i * size, size);
+        EXPECT_EQ(PhPacker::KeyFormat(std::string(1, code)).pack(values[i]),
+                  key)
+            << code << " " << values[i];
+        if (i > 0) {
+            EXPECT_LE(keys.substr((i - 1) * size, size), key)
+                << code << " " << values[i - 1] << " " << values[i];
+        }
+    }
+
+    std::vector<T> decoded(values.size());
+    PhPacker::decode_keys(code, keys.data(), decoded.size(), decoded.data());
+    EXPECT_EQ(decoded, values) << code;
+}
+
+} // namespace
+
+TEST(PhPackerSortKey, Integers)
+{
+    std::vector<int64_t> values = {std::numeric_limits<int64_t>::min(),
+                                   std::numeric_limits<int64_t>::max(), 0, -1,
+                                   1, 255, -256};
+    for (int64_t i = -1000; i < 1000; i += 37) {
+        values.push_back(i * 1000003);
+    }
+    check_order('q', values);
+
+    std::vector<int32_t> ints;
+    for (int32_t i = -100000; i < 100000; i += 997) {
+        ints.push_back(i);
+    }
+    ints.push_back(std::numeric_limits<int32_t>::min());
+    check_order('l', ints);
+    check_order('V', std::vector<uint32_t>{0, 1, 256, 65536, 0xffffffff});
+
+    std::vector<int16_t> shorts = {-32768, -1, 0, 1, 32767, -300, 300};
+    check_order('s', shorts);
+    check_order('c', std::vector<int>{-128, -1, 0, 1, 127});
+}
+
+TEST(PhPackerSortKey, Floats)
+{
+    std::vector<double> values = {-std::numeric_limits<double>::infinity(),
+                                  std::numeric_limits<double>::infinity(),
+                                  -1e300, -1.5, -1e-300, 0.0, 1e-300, 0.25,
+                                  3.0, 1e300};
+    for (int i = -50; i < 50; ++i) {
+        values.push_back(i * 0.37);
+    }
+    check_order('E', values);
+    check_order('e', values);
+
+    /* without the values that round to -0 or +0, they compare equal */
+    std::vector<float> floats;
+    for (double d : values) {
+        if (std::isfinite(d) && (d == 0.0 || std::fabs(d) > 1e-30)) {
+            floats.push_back(static_cast<float>(d));
+        }
+    }
+    check_order('g', floats);
+
+    /* -0 sorts before +0 */
+    const PhPacker::KeyFormat f("d");
+    EXPECT_LT(f.pack(-0.0), f.pack(0.0));
+}
+
+TEST(PhPackerSortKey, Composite)
+{
+    const PhPacker::KeyFormat format("qla4E");
+    using Key = std::tuple<int64_t, int32_t, std::string, double>;
+    std::vector<Key> keys = {
+        {-5, 3, "ab", 1.0}, {-5, -3, "ab", 1.0}, {-5, -3, "aa", 2.0},
+        {-5, -3, "aa", -2.0}, {7, 0, "", 0.0}, {-6, 100, "zz", 9.0},
+        {7, 0, "", -0.5}};
+
+    std::vector<std::string> packed;
+    for (const auto &k : keys) {
+        packed.push_back(format.pack(std::get<0>(k), std::get<1>(k),
+                                     std::string_view(std::get<2>(k)),
+                                     std::get<3>(k)));
+    }
+
+    std::vector<size_t> by_value(keys.size());
+    std::vector<size_t> by_key(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        by_value[i] = by_key[i] = i;
+    }
+    std::sort(by_value.begin(), by_value.end(),
+              [&](size_t a, size_t b) { return keys[a] < keys[b]; });
+    std::sort(by_key.begin(), by_key.end(),
+              [&](size_t a, size_t b) { return packed[a] < packed[b]; });
+    EXPECT_EQ(by_key, by_value);
+
+    const auto values = format.unpack(packed[1]);
+    ASSERT_EQ(values.size(), 4);
+    EXPECT_EQ(std::any_cast<int64_t>(values[0]), -5);
+    EXPECT_EQ(std::any_cast<int32_t>(values[1]), -3);
+    EXPECT_DOUBLE_EQ(std::any_cast<double>(values[3]), 1.0);
+
+    EXPECT_THROW(PhPacker::KeyFormat("a*N"), std::invalid_argument);
+    EXPECT_THROW(PhPacker::KeyFormat("h4"), std::invalid_argument);
+    EXPECT_NO_THROW(PhPacker::KeyFormat("Na*"));
+}
@@ -0,0 +1,98 @@
+#include "../include/unpack_format.h"
+
+#include "gtest/gtest.h"
+#include <stdexcept>
+
+TEST(PhPackerUnpackFormat, Keys)
+{
+    PhPacker::UnpackFormat format("Nlen/nflags/C4bytes/C1one/C/v2");
+    std::vector<std::string> keys = {"len",    "flags",  "bytes1", "bytes2",
+                                     "bytes3", "bytes4", "one",    "1",
+                                     "2"};
+    EXPECT_EQ(format.keys(), keys);
+}
+
+TEST(PhPackerUnpackFormat, Named)
+{
+    std::string data = PhPacker::pack("NnC4", 655351234u, 65535, 1, 2, 3, 4);
+    PhPacker::UnpackFormat format("Nlen/nflags/C4bytes");
+    PhPacker::UnpackResult result = format.unpack(data);
+
+    ASSERT_EQ(result.size(), 6u);
+    EXPECT_EQ(result.get<uint32_t>("len"), 655351234u);
+    EXPECT_EQ(result.get<uint16_t>("flags"), 65535);
+    EXPECT_EQ(result.get<unsigned char>("bytes1"), 1);
+    EXPECT_EQ(result.get<unsigned char>("bytes4"), 4);
+    EXPECT_EQ(result.key(2), "bytes1");
+    EXPECT_EQ(result.find("bytes5"), nullptr);
+    EXPECT_THROW(result.get<uint32_t>("bytes5"), std::out_of_range);
+
+    /* the same result is reused for the next message */
+    data = PhPacker::pack("NnC4", 7u, 8, 9, 10, 11, 12);
+    format.unpack(data, result);
+    ASSERT_EQ(result.size(), 6u);
+    EXPECT_EQ(result.get<uint32_t>("len"), 7u);
+    EXPECT_EQ(result.get<unsigned char>("bytes4"), 12);
+}
+
+TEST(PhPackerUnpackFormat, DuplicateKeys)
+{
+    /* like php, the second value overwrites the first */
+    PhPacker::UnpackFormat format("C/C");
+    PhPacker::UnpackResult result = format.unpack(std::string("\x01\x02", 2));
+    ASSERT_EQ(result.size(), 1u);
+    EXPECT_EQ(result.get<unsigned char>("1"), 2);
+}
+
+TEST(PhPackerUnpackFormat, Strings)
+{
+    std::string data("ab\0\0cd  \0ef\0gh\x12\x34\x56", 17);
+    PhPacker::UnpackFormat format("a4raw/A5spaced/Z4zero/H4high/h2low/a*rest");
+    PhPacker::UnpackResult result = format.unpack(data);
+
+    EXPECT_EQ(result.get<std::string>("raw"), std::string("ab\0\0", 4));
+    EXPECT_EQ(result.get<std::string>("spaced"), "cd");
+    EXPECT_EQ(result.get<std::string>("zero"), "ef");
+    EXPECT_EQ(result.get<std::string>("high"), "6812");
+    EXPECT_EQ(result.get<std::string>("low"), "43");
+    EXPECT_EQ(result.get<std::string>("rest"), "\x56");
+}
+
+TEST(PhPackerUnpackFormat, Repeat)
+{
+    std::string data = PhPacker::pack("nC3", 2, 10, 20, 30);
+    PhPacker::UnpackFormat format("ncount/C*items");
+    PhPacker::UnpackResult result = format.unpack(data);
+
+    ASSERT_EQ(result.size(), 4u);
+    EXPECT_EQ(result.get<uint16_t>("count"), 2);
+    EXPECT_EQ(result.get<unsigned char>("items1"), 10);
+    EXPECT_EQ(result.get<unsigned char>("items3"), 30);
+    EXPECT_EQ(result.key(3), "items3");
+
+    format.unpack(PhPacker::pack("nC", 1, 40), result);
+    ASSERT_EQ(result.size(), 2u);
+    EXPECT_EQ(result.get<unsigned char>("items1"), 40);
+    EXPECT_EQ(result.find("items2"), nullptr);
+}
+
+TEST(PhPackerUnpackFormat, Position)
+{
+    std::string data = PhPacker::pack("CCCC", 1, 2, 3, 4);
+    PhPacker::UnpackFormat format("x2/Cthird/X2/Csecond/@0/Cfirst");
+    PhPacker::UnpackResult result = format.unpack(data);
+    EXPECT_EQ(result.get<unsigned char>("third"), 3);
+    EXPECT_EQ(result.get<unsigned char>("second"), 2);
+    EXPECT_EQ(result.get<unsigned char>("first"), 1);
+}
+
+TEST(PhPackerUnpackFormat, Errors)
+{
+    EXPECT_THROW(PhPacker::UnpackFormat("Ylen"), std::invalid_argument);
+    EXPECT_THROW(PhPacker::UnpackFormat("N").unpack(std::string("ab")),
+                 std::out_of_range);
+    EXPECT_THROW(PhPacker::UnpackFormat("X").unpack(std::string("ab")),
+                 std::out_of_range);
+    EXPECT_THROW(PhPacker::UnpackFormat("a3").unpack(std::string("ab")),
+                 std::out_of_range);
+}
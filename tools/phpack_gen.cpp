@@ -0,0 +1,473 @@
+/**
+ * Copyright (c) 2020 Waqar Ahmed
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * phpack_gen: generates header only encode/decode functions from a schema
+ *
+ * usage: phpack_gen <schema.txt> <output.h>
+ *
+ * Schema syntax, one statement per line, '#' starts a comment:
+ *
+ *   namespace telemetry
+ *   record Header
+ *       length N
+ *       flags n
+ *       samples v4
+ *   end
+ *
+ * Every field is a name and a numeric pack() code with an optional repeat
+ * count, repeated fields become std::array members.
+ */
+#include "../include/pack.h"
+
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct Field {
+    std::string name;
+    char code;
+    size_t count;
+    bool is_array;
+};
+
+struct Record {
+    std::string name;
+    std::vector<Field> fields;
+};
+
+struct Schema {
+    std::string ns;
+    std::vector<Record> records;
+};
+
+struct SchemaError {
+    size_t line;
+    std::string what;
+};
+
+/* C++17 keywords and alternative tokens, which can't name anything */
+const char *const keywords[] = {
+    "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor",
+    "bool", "break", "case", "catch", "char", "char16_t", "char32_t", "class",
+    "compl", "const", "const_cast", "constexpr", "continue", "decltype",
+    "default", "delete", "do", "double", "dynamic_cast", "else", "enum",
+    "explicit", "export", "extern", "false", "float", "for", "friend", "goto",
+    "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept",
+    "not", "not_eq", "nullptr", "operator", "or", "or_eq", "private",
+    "protected", "public", "register", "reinterpret_cast", "return", "short",
+    "signed", "sizeof", "static", "static_assert", "static_cast", "struct",
+    "switch", "template", "this", "thread_local", "throw", "true", "try",
+    "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual",
+    "void", "volatile", "wchar_t", "while", "xor", "xor_eq",
+};
+
+bool is_identifier(const std::string &s) {
+    if (s.empty() || std::isdigit(static_cast<unsigned char>(s[0]))) {
+        return false;
+    }
+    for (const char *keyword : keywords) {
+        if (s == keyword) {
+            return false;
+        }
+    }
+    for (char c : s) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* an identifier or nested identifiers, e.g. acme::telemetry */
+bool is_namespace_name(const std::string &s) {
+    size_t start = 0;
+    for (size_t sep; (sep = s.find("::", start)) != std::string::npos;
+         start = sep + 2) {
+        if (!is_identifier(s.substr(start, sep - start))) {
+            return false;
+        }
+    }
+    return is_identifier(s.substr(start));
+}
+
+const char *cpp_type(char code) {
+    switch (code) {
+    case 'c':
+        return "int8_t";
+    case 'C':
+        return "uint8_t";
+    case 's':
+        return "int16_t";
+    case 'S':
+    case 'n':
+    case 'v':
+        return "uint16_t";
+    case 'i':
+        return "int";
+    case 'I':
+        return "unsigned int";
+    case 'l':
+        return "int32_t";
+    case 'L':
+    case 'N':
+    case 'V':
+        return "uint32_t";
+    case 'q':
+        return "int64_t";
+    case 'Q':
+    case 'J':
+    case 'P':
+        return "uint64_t";
+    case 'f':
+    case 'g':
+    case 'G':
+        return "float";
+    case 'd':
+    case 'e':
+    case 'E':
+        return "double";
+    }
+    return nullptr;
+}
+
+/* php_store_uint/php_load_uint take and return these without a cast */
+bool is_uint64(char code) {
+    return code == 'Q' || code == 'J' || code == 'P';
+}
+
+/* byte order argument of php_store_uint/php_load_uint */
+const char *byte_order(char code) {
+    switch (code) {
+    case 'v':
+    case 'V':
+    case 'P':
+    case 'g':
+    case 'e':
+        return "true";
+    case 'n':
+    case 'N':
+    case 'J':
+    case 'G':
+    case 'E':
+        return "false";
+    }
+    return "is_little_endian()";
+}
+
+Field parse_field(const std::string &name, const std::string &code,
+                  size_t line) {
+    if (!is_identifier(name)) {
+        throw SchemaError{line, "invalid field name '" + name + "'"};
+    }
+    /* the generated struct already has these members */
+    if (name == "format" || name == "packed_size") {
+        throw SchemaError{line, "reserved field name '" + name + "'"};
+    }
+    if (code.empty() || cpp_type(code[0]) == nullptr ||
+        PhPacker::__phpack__detail::php_pack_code_size(code[0]) == 0) {
+        throw SchemaError{line, "unsupported code '" + code + "'"};
+    }
+
+    Field field{name, code[0], 1, false};
+    if (code.size() > 1) {
+        const std::string count = code.substr(1);
+        for (char c : count) {
+            if (!std::isdigit(static_cast<unsigned char>(c))) {
+                throw SchemaError{line, "invalid repeat count '" + count + "'"};
+            }
+        }
+        try {
+            field.count = std::stoul(count);
+        } catch (const std::out_of_range &) {
+            throw SchemaError{line,
+                              "repeat count '" + count + "' is too large"};
+        }
+        field.is_array = true;
+        if (field.count == 0) {
+            throw SchemaError{line, "repeat count must be positive"};
+        }
+    }
+    return field;
+}
+
+Schema parse_schema(std::istream &in) {
+    Schema schema;
+    Record *record = nullptr;
+    std::string text;
+    size_t line = 0;
+
+    while (std::getline(in, text)) {
+        ++line;
+        const auto comment = text.find('#');
+        if (comment != std::string::npos) {
+            text.erase(comment);
+        }
+
+        std::istringstream words(text);
+        std::string first, second, rest;
+        if (!(words >> first)) {
+            continue;
+        }
+        words >> second >> rest;
+        if (!rest.empty()) {
+            throw SchemaError{line, "unexpected '" + rest + "'"};
+        }
+
+        if (first == "namespace" && record == nullptr) {
+            if (!is_namespace_name(second)) {
+                throw SchemaError{line, "invalid namespace '" + second + "'"};
+            }
+            schema.ns = second;
+        } else if (first == "record" && record == nullptr) {
+            if (!is_identifier(second)) {
+                throw SchemaError{line, "invalid record name '" + second + "'"};
+            }
+            for (const Record &other : schema.records) {
+                if (other.name == second) {
+                    throw SchemaError{line, "duplicate record name '" +
+                                                second + "'"};
+                }
+            }
+            schema.records.push_back({second, {}});
+            record = &schema.records.back();
+        } else if (first == "end" && second.empty() && record != nullptr) {
+            if (record->fields.empty()) {
+                throw SchemaError{line, "record '" + record->name +
+                                            "' has no fields"};
+            }
+            record = nullptr;
+        } else if (record != nullptr) {
+            Field field = parse_field(first, second, line);
+            for (const Field &other : record->fields) {
+                if (other.name == field.name) {
+                    throw SchemaError{line, "duplicate field name '" +
+                                                field.name + "'"};
+                }
+            }
+            record->fields.push_back(std::move(field));
+        } else {
+            throw SchemaError{line, "unexpected '" + first + "'"};
+        }
+    }
+
+    if (record != nullptr) {
+        throw SchemaError{line, "missing 'end' for record '" + record->name +
+                                    "'"};
+    }
+    return schema;
+}
+
+std::string member(const Field &field, size_t i) {
+    return "r." + field.name +
+           (field.is_array ? "[" + std::to_string(i) + "]" : std::string());
+}
+
+void write_encode(std::ostream &out, const Record &record) {
+    out << "inline void encode(const " << record.name
+        << " &r, char *out) noexcept {\n"
+        << "    using namespace PhPacker::__phpack__detail;\n";
+    size_t offset = 0;
+    for (const Field &field : record.fields) {
+        const size_t size = PhPacker::__phpack__detail::php_pack_code_size(
+            field.code);
+        for (size_t i = 0; i < field.count; ++i, offset += size) {
+            const std::string store = "php_store_uint<" +
+                                      std::to_string(size) + ", " +
+                                      byte_order(field.code) + ">";
+            if (PhPacker::__phpack__detail::php_pack_code_is_float(
+                    field.code)) {
+                out << "    {\n"
+                    << "        uint" << size * 8 << "_t bits{};\n"
+                    << "        memcpy(&bits, &" << member(field, i) << ", "
+                    << size << ");\n"
+                    << "        " << store << "(bits, out + " << offset
+                    << ");\n"
+                    << "    }\n";
+            } else if (is_uint64(field.code)) {
+                out << "    " << store << "(" << member(field, i)
+                    << ", out + " << offset << ");\n";
+            } else {
+                out << "    " << store << "(static_cast<uint64_t>("
+                    << member(field, i) << "), out + " << offset << ");\n";
+            }
+        }
+    }
+    out << "}\n\n";
+
+    out << "inline std::string encode(const " << record.name << " &r) {\n"
+        << "    std::string output(" << record.name
+        << "::packed_size, '\\0');\n"
+        << "    encode(r, &output[0]);\n"
+        << "    return output;\n"
+        << "}\n\n";
+}
+
+void write_decode(std::ostream &out, const Record &record) {
+    out << "inline void decode(const char *in, " << record.name
+        << " &r) noexcept {\n"
+        << "    using namespace PhPacker::__phpack__detail;\n";
+    size_t offset = 0;
+    for (const Field &field : record.fields) {
+        const size_t size = PhPacker::__phpack__detail::php_pack_code_size(
+            field.code);
+        for (size_t i = 0; i < field.count; ++i, offset += size) {
+            const std::string load = "php_load_uint<" + std::to_string(size) +
+                                     ", " + byte_order(field.code) + ">(in + " +
+                                     std::to_string(offset) + ")";
+            if (PhPacker::__phpack__detail::php_pack_code_is_float(
+                    field.code)) {
+                out << "    {\n";
+                if (size == 8) {
+                    out << "        const uint64_t bits = " << load << ";\n";
+                } else {
+                    out << "        const auto bits = static_cast<uint"
+                        << size * 8 << "_t>(" << load << ");\n";
+                }
+                out
+                    << "        memcpy(&" << member(field, i) << ", &bits, "
+                    << size << ");\n"
+                    << "    }\n";
+            } else if (is_uint64(field.code)) {
+                out << "    " << member(field, i) << " = " << load << ";\n";
+            } else {
+                out << "    " << member(field, i) << " = static_cast<"
+                    << cpp_type(field.code) << ">(" << load << ");\n";
+            }
+        }
+    }
+    out << "}\n\n";
+}
+
+void write_header(std::ostream &out, const Schema &schema,
+                  const std::string &source, const std::string &guard) {
+    out << "/* generated by phpack_gen from " << source
+        << ", do not edit */\n"
+        << "#ifndef " << guard << "\n"
+        << "#define " << guard << "\n\n"
+        << "#include \"pack.h\"\n\n"
+        << "#include <array>\n"
+        << "#include <cstddef>\n"
+        << "#include <cstdint>\n"
+        << "#include <cstring>\n"
+        << "#include <string>\n\n";
+    if (!schema.ns.empty()) {
+        out << "namespace " << schema.ns << " {\n\n";
+    }
+
+    for (const Record &record : schema.records) {
+        std::string format;
+        size_t size = 0;
+        for (const Field &field : record.fields) {
+            format += field.code;
+            if (field.is_array) {
+                format += std::to_string(field.count);
+            }
+            size += field.count *
+                    PhPacker::__phpack__detail::php_pack_code_size(field.code);
+        }
+
+        out << "struct " << record.name << " {\n"
+            << "    static constexpr const char *format = \"" << format
+            << "\";\n"
+            << "    static constexpr size_t packed_size = " << size << ";\n\n";
+        for (const Field &field : record.fields) {
+            if (field.is_array) {
+                out << "    std::array<" << cpp_type(field.code) << ", "
+                    << field.count << "> " << field.name << ";\n";
+            } else {
+                out << "    " << cpp_type(field.code) << " " << field.name
+                    << ";\n";
+            }
+        }
+        out << "};\n\n";
+
+        write_encode(out, record);
+        write_decode(out, record);
+    }
+
+    if (!schema.ns.empty()) {
+        out << "} // namespace " << schema.ns << "\n\n";
+    }
+    out << "#endif /* " << guard << " */\n";
+}
+
+std::string include_guard(const std::string &path) {
+    std::string name = path.substr(path.find_last_of("/\\") + 1);
+    std::string guard = "PHPACK_GENERATED_";
+    for (char c : name) {
+        guard += std::isalnum(static_cast<unsigned char>(c))
+                     ? static_cast<char>(
+                           std::toupper(static_cast<unsigned char>(c)))
+                     : '_';
+    }
+    return guard;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        std::cerr << "usage: " << argv[0] << " <schema.txt> <output.h>\n";
+        return 2;
+    }
+
+    std::ifstream in(argv[1]);
+    if (!in) {
+        std::cerr << argv[1] << ": cannot open schema\n";
+        return 1;
+    }
+
+    Schema schema;
+    try {
+        schema = parse_schema(in);
+    } catch (const SchemaError &e) {
+        std::cerr << argv[1] << ":" << e.line << ": " << e.what << "\n";
+        return 1;
+    }
+
+    const std::string source = argv[1];
+    std::ostringstream header;
+    write_header(header, schema, source.substr(source.find_last_of("/\\") + 1),
+                 include_guard(argv[2]));
+
+    std::ofstream out(argv[2], std::ios::binary);
+    if (!(out << header.str())) {
+        std::cerr << argv[2] << ": cannot write output\n";
+        return 1;
+    }
+    return 0;
+}